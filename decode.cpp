@@ -1,18 +1,7 @@
-#include <sstream>
 #include <string>
 #include <unordered_map>
 #include "simulator.h"
 
-MIPS32_Simulator::decodeFunction MIPS32_Simulator::getInstructionFunc(std::string identifier) const
-{
-    if(INSTRUCTION_NAMES.find(identifier) == INSTRUCTION_NAMES.end()) //identifier not in map
-    {
-        return INSTRUCTION_NAMES.at("nop"); //default to nop
-    }
-
-    return INSTRUCTION_NAMES.at(identifier);
-}
-
 void MIPS32_Simulator::applyStoreOpCodes()
 {
     //Store instruction
@@ -61,29 +50,26 @@ void MIPS32_Simulator::applyBranchOpCodes()
     id_ex[8] = 0; //RegDst
 }
 
-void MIPS32_Simulator::applyRTypeCodes(std::istringstream& stringStream)
+void MIPS32_Simulator::applyRTypeCodes(const DecodedInstruction& instruction)
 {
     //R-type
-    std::string dest, src, targ;
-    stringStream >> dest >> src >> targ;
-    dest = dest.substr(0, dest.length() - 1); //remove comma
-    src = src.substr(0, src.length() - 1); //remove comma
-
     int rd, rs, rt;
-    rd = getRegisterIndex(dest);
-    rs = getRegisterIndex(src);
-    if(targ[0] == '$') //register name
+    rd = instruction.rd;
+    rs = instruction.rs;
+    if(!instruction.immOperand) //register name
     {
-        rt = getRegisterIndex(targ);
+        rt = instruction.rt;
         id_ex[1] = registerFile[rt]; //ReadData2 = register file at rt
+        id_ex_record.src2 = rt;
     }
     else
     {
-        rt = std::stoi(targ); //sll or srl
+        rt = instruction.imm; //sll or srl
         id_ex[1] = rt; //ReadData2 = rt
     }
 
     id_ex[0] = registerFile[rs]; //ReadData1 = register file at rs
+    id_ex_record.src1 = rs;
     id_ex[9] = rt; //WriteAddr1 = rt
     id_ex[10] = rd; //WriteAddr2 = rd
     id_ex[11] = 0; //Offset = 0
@@ -91,194 +77,160 @@ void MIPS32_Simulator::applyRTypeCodes(std::istringstream& stringStream)
 
 /* Instruction-specific decode functions */
 
-void MIPS32_Simulator::decode_sw(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_sw(const DecodedInstruction& instruction)
 {
     applyStoreOpCodes();
 
-    std::string storeSource, storeOffset, storeTarget;
-    stringStream >> storeTarget;
-    storeTarget = storeTarget.substr(0, storeTarget.length() - 1); //remove comma
-    stringStream >> storeOffset;
-
-    //extract storeSource
-    int startLoc, endLoc;
-    startLoc = storeOffset.find('(');
-    endLoc = storeOffset.find(')');
-    storeSource = storeOffset.substr(startLoc + 1, endLoc - startLoc - 1); //get register source
-    storeOffset = storeOffset.substr(0, startLoc); //leave only the offset here
-
-    id_ex[0] = registerFile[getRegisterIndex(storeSource)]; //ReadData1 = register contents at source (addr)
-    id_ex[1] = registerFile[getRegisterIndex(storeTarget)]; //ReadData2 = register contents at target (data)
+    id_ex[0] = registerFile[instruction.rs]; //ReadData1 = register contents at source (addr)
+    id_ex[1] = registerFile[instruction.rt]; //ReadData2 = register contents at target (data)
+    id_ex_record.opcode = OP_SW;
+    id_ex_record.src1 = instruction.rs;
+    id_ex_record.src2 = instruction.rt;
     id_ex[9] = 0; //WriteAddr1 = 0;
     id_ex[10] = 0; //WriteAddr2 = 0
-    id_ex[11] = std::stoi(storeOffset); //Offset = storeOffset
+    id_ex[11] = instruction.imm; //Offset = storeOffset
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_lw(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_lw(const DecodedInstruction& instruction)
 {
     applyLoadOpCodes();
 
-    std::string loadSource, loadOffset, loadTarget;
-    stringStream >> loadTarget;
-    loadTarget = loadTarget.substr(0, loadTarget.length() - 1); //remove comma
-    stringStream >> loadOffset;
-
-    //extract loadSource
-    int startLoc, endLoc;
-    startLoc = loadOffset.find('(');
-    endLoc = loadOffset.find(')');
-    loadSource = loadOffset.substr(startLoc + 1, endLoc - startLoc - 1); //get register source
-    loadOffset = loadOffset.substr(0, startLoc); //leave only the offset here
-
-    id_ex[0] = registerFile[getRegisterIndex(loadSource)]; //ReadData1 = register contents at source (addr)
+    id_ex[0] = registerFile[instruction.rs]; //ReadData1 = register contents at source (addr)
+    id_ex_record.opcode = OP_LW;
+    id_ex_record.src1 = instruction.rs;
     id_ex[1] = 0; //ReadData2 = 0
-    id_ex[9] = getRegisterIndex(loadTarget); //WriteAddr1 = loadTarget
+    id_ex[9] = instruction.rd; //WriteAddr1 = loadTarget
     id_ex[10] = 0; //WriteAddr2 = 0
-    id_ex[11] = std::stoi(loadOffset);
+    id_ex[11] = instruction.imm;
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_add(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_add(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_ADD;
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_addi(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_addi(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-        
-    std::string dest, src;
-    int imm;
-
-    stringStream >> dest >> src >> imm;
-    dest = dest.substr(0, dest.length() - 1); //remove comma
-    src = src.substr(0, src.length() - 1); //remove comma
 
-    id_ex[0] = registerFile[getRegisterIndex(src)]; //ReadData1 = contents of register file at src
-    id_ex[1] = imm; //ReadData2 = imm
+    id_ex[0] = registerFile[instruction.rs]; //ReadData1 = contents of register file at src
+    id_ex[1] = instruction.imm; //ReadData2 = imm
+    id_ex_record.opcode = OP_ADDI;
+    id_ex_record.src1 = instruction.rs;
     id_ex[9] = 0;
-    id_ex[10] = getRegisterIndex(dest); //WriteAddr2 = index at dest
+    id_ex[10] = instruction.rd; //WriteAddr2 = index at dest
     id_ex[11] = 0;
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_sub(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_sub(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_SUB;
     id_ex[12] = SUB;
 }
 
-void MIPS32_Simulator::decode_mult(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_mult(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_MULT;
     id_ex[12] = MULT;
 }
 
-void MIPS32_Simulator::decode_and(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_and(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_AND;
     id_ex[12] = AND;
 }
 
-void MIPS32_Simulator::decode_or(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_or(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_OR;
     id_ex[12] = OR;
 }
 
-void MIPS32_Simulator::decode_sll(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_sll(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_SLL;
     id_ex[12] = SLL;
 }
 
-void MIPS32_Simulator::decode_srl(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_srl(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
-    applyRTypeCodes(stringStream);
+    applyRTypeCodes(instruction);
+    id_ex_record.opcode = OP_SRL;
     id_ex[12] = SRL;
 }
 
-void MIPS32_Simulator::decode_li(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_li(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
 
-    std::string li_src;
-    int imm;
-    stringStream >> li_src >> imm;
-    li_src = li_src.substr(0, li_src.length() - 1); //remove comma
-
-    id_ex[0] = imm; //ReadData1 = imm
+    id_ex[0] = instruction.imm; //ReadData1 = imm
+    id_ex_record.opcode = OP_LI;
     id_ex[1] = 0;
     id_ex[9] = 0;
-    id_ex[10] = getRegisterIndex(li_src); //WriteAddr2 = register number at li_src
+    id_ex[10] = instruction.rd; //WriteAddr2 = register number at li_src
     id_ex[11] = 0;
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_la(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_la(const DecodedInstruction& instruction)
 {
     applyALUOpCodes();
 
-    std::string la_dst, la_tag;
-    int addr;
-    stringStream >> la_dst >> la_tag;
-    la_dst = la_dst.substr(0, la_dst.length() - 1); //remove comma
-    addr = dataLabels[la_tag];
-
-    id_ex[0] = addr; //ReadData1 = addr
+    id_ex[0] = instruction.imm; //ReadData1 = addr of the data label
+    id_ex_record.opcode = OP_LA;
     id_ex[1] = 0;
     id_ex[9] = 0;
-    id_ex[10] = getRegisterIndex(la_dst); //WriteAddr2 = register number at la_dst
+    id_ex[10] = instruction.rd; //WriteAddr2 = register number at la_dst
     id_ex[11] = 0;
     id_ex[12] = ADD;
 }
 
-void MIPS32_Simulator::decode_beq(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_beq(const DecodedInstruction& instruction)
 {
     applyBranchOpCodes();
 
-    std::string src, targ, label;
-    int branchIndex;
-    stringStream >> src >> targ >> label;
-    src = src.substr(0, src.length() - 1);
-    targ = targ.substr(0, targ.length() - 1);
-    branchIndex = textLabels[label];
-
-    id_ex[0] = registerFile[getRegisterIndex(src)];
-    id_ex[1] = registerFile[getRegisterIndex(targ)];
+    id_ex[0] = registerFile[instruction.rs];
+    id_ex[1] = registerFile[instruction.rt];
+    id_ex_record.opcode = OP_BEQ;
+    id_ex_record.src1 = instruction.rs;
+    id_ex_record.src2 = instruction.rt;
     id_ex[9] = 0;
     id_ex[10] = 0;
-    id_ex[11] = branchIndex;
+    id_ex[11] = instruction.imm; //index of the label
     id_ex[12] = SUB;
 }
 
-void MIPS32_Simulator::decode_j(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_j(const DecodedInstruction& instruction)
 {
     applyBranchOpCodes();
 
-    std::string label;
-    int jumpIndex;
-    stringStream >> label;
-    jumpIndex = textLabels[label]; //jumpindex obtained from label mapping
-
     id_ex[0] = 0; //ReadData1 = 0
     id_ex[1] = 0; //ReadData2 = 0
+    id_ex_record.opcode = OP_J;
     id_ex[9] = 0; //WriteAddr1 = 0
     id_ex[10] = 0; //WriteAddr2 = 0
-    id_ex[11] = jumpIndex; //Offset = jumpIndex
+    id_ex[11] = instruction.imm; //Offset = jumpIndex obtained from label mapping
     id_ex[12] = 0; //ALU OP = 0
 } 
 
-void MIPS32_Simulator::decode_nop(std::istringstream& stringStream)
+void MIPS32_Simulator::decode_nop(const DecodedInstruction& instruction)
 {
     //NOP
     id_ex[0] = 0; //ReadData1
@@ -0,0 +1,138 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <charconv>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dump.h"
+
+namespace
+{
+    const int CELL_WIDTH = 20;
+    const int CELLS_PER_ROW = 4;
+    const int MAX_CELL_LENGTH = 25; //"[2147483647]: -2147483648"
+
+    bool writeAll(int fd, const char* data, size_t size)
+    {
+        while(size > 0)
+        {
+            ssize_t n = write(fd, data, size);
+            if(n < 0)
+            {
+                if(errno == EINTR)
+                {
+                    continue;
+                }
+                return false;
+            }
+            data += n;
+            size -= n;
+        }
+        return true;
+    }
+
+    char* formatCell(char* out, int index, int value)
+    {
+        char* start = out;
+        *out++ = '[';
+        out = std::to_chars(out, out + 11, index).ptr;
+        *out++ = ']';
+        *out++ = ':';
+        *out++ = ' ';
+        out = std::to_chars(out, out + 11, value).ptr;
+        while(out - start < CELL_WIDTH)
+        {
+            *out++ = ' ';
+        }
+        return out;
+    }
+
+    void clampRange(int count, int& begin, int& end)
+    {
+        begin = std::max(begin, 0);
+        end = (end < 0 || end > count) ? count : end;
+        end = std::max(begin, end);
+    }
+}
+
+bool writeDump(int fd, const int* values, int count, const DumpOptions& options, std::vector<char>& buffer)
+{
+    int begin = options.begin;
+    int end = options.end;
+    clampRange(count, begin, end);
+
+    size_t bound = (size_t)(end - begin) * (MAX_CELL_LENGTH + 1) + 1;
+    if(buffer.size() < bound)
+    {
+        buffer.resize(bound);
+    }
+
+    char* out = buffer.data();
+    int column = 0;
+    for(int i = begin; i < end; i++)
+    {
+        if((options.nonZeroOnly && values[i] == 0)
+           || (options.initial && i < options.initial->size() && (*options.initial)[i] == values[i]))
+        {
+            continue;
+        }
+
+        out = formatCell(out, i, values[i]);
+        if(++column == CELLS_PER_ROW)
+        {
+            *out++ = '\n';
+            column = 0;
+        }
+    }
+    if(column > 0)
+    {
+        *out++ = '\n';
+    }
+
+    std::cout.flush();
+    return writeAll(fd, buffer.data(), out - buffer.data());
+}
+
+bool writeMemoryImage(const std::string& fileName, const std::vector<int>& memory, int begin, int end, bool hex)
+{
+    clampRange(memory.size(), begin, end);
+
+    std::vector<char> buffer((size_t)(end - begin) * (hex ? 9 : 4));
+    char* out = buffer.data();
+    for(int i = begin; i < end; i++)
+    {
+        unsigned int word = memory[i];
+        if(hex)
+        {
+            const char* digits = "0123456789abcdef";
+            for(int shift = 28; shift >= 0; shift -= 4)
+            {
+                *out++ = digits[(word >> shift) & 0xf];
+            }
+            *out++ = '\n';
+        }
+        else
+        {
+            *out++ = word >> 24;
+            *out++ = word >> 16;
+            *out++ = word >> 8;
+            *out++ = word;
+        }
+    }
+
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd == -1)
+    {
+        std::cout << "Memory image \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+    bool ok = writeAll(fd, buffer.data(), out - buffer.data());
+    close(fd);
+    if(!ok)
+    {
+        std::cout << "Memory image \"" << fileName << "\" could not be written" << std::endl;
+    }
+    return ok;
+}
@@ -0,0 +1,23 @@
+#ifndef DUMP_H
+#define DUMP_H
+
+#include <string>
+#include <vector>
+
+//Which cells of a register file or memory dump to print
+struct DumpOptions
+{
+    int begin = 0; //first index
+    int end = -1; //one past the last index, -1 = to the end
+    bool nonZeroOnly = false;
+    const std::vector<int>* initial = nullptr; //when set, only cells whose value differs from this image
+};
+
+//Formats the selected cells as "[i]: v" padded to 20 characters, four per row, into buffer (grown as needed and
+//reused between calls) and writes it to fd in one write(). std::cout is flushed first so the output stays in order
+bool writeDump(int fd, const int* values, int count, const DumpOptions& options, std::vector<char>& buffer);
+
+//Writes memory words [begin, end) to fileName as big-endian binary, or as one 8-digit hex word per line
+bool writeMemoryImage(const std::string& fileName, const std::vector<int>& memory, int begin, int end, bool hex);
+
+#endif
@@ -0,0 +1,603 @@
+#include <iostream>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "gdbstub.h"
+
+namespace
+{
+    const int GDB_REGISTER_COUNT = 38; //r0-r31, sr, lo, hi, bad, cause, pc
+    const int GDB_PC_REGISTER = 37;
+    const long long CYCLES_BETWEEN_INTERRUPT_CHECKS = 1 << 16;
+
+    struct GdbConnection
+    {
+        int fd;
+        bool noAck;
+        char buffer[4096];
+        int bufferStart;
+        int bufferEnd;
+    };
+
+    bool readByte(GdbConnection& connection, char& c)
+    {
+        if(connection.bufferStart == connection.bufferEnd)
+        {
+            int n = recv(connection.fd, connection.buffer, sizeof(connection.buffer), 0);
+            if(n <= 0)
+            {
+                return false;
+            }
+            connection.bufferStart = 0;
+            connection.bufferEnd = n;
+        }
+        c = connection.buffer[connection.bufferStart++];
+        return true;
+    }
+
+    bool sendRaw(GdbConnection& connection, const std::string& data)
+    {
+        size_t sent = 0;
+        while(sent < data.size())
+        {
+            int n = send(connection.fd, data.data() + sent, data.size() - sent, 0);
+            if(n <= 0)
+            {
+                return false;
+            }
+            sent += n;
+        }
+        return true;
+    }
+
+    int hexValue(char c)
+    {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    std::string hexByte(unsigned int b)
+    {
+        const char* digits = "0123456789abcdef";
+        return std::string(1, digits[(b >> 4) & 0xf]) + digits[b & 0xf];
+    }
+
+    std::string hexWord(unsigned int value) //big-endian target byte order
+    {
+        return hexByte(value >> 24) + hexByte(value >> 16) + hexByte(value >> 8) + hexByte(value);
+    }
+
+    unsigned int parseWord(const std::string& hex, size_t offset) //8 hex digits, big-endian
+    {
+        unsigned int value = 0;
+        for(size_t i = offset; i < offset + 8 && i < hex.size(); i++)
+        {
+            value = (value << 4) | (hexValue(hex[i]) & 0xf);
+        }
+        return value;
+    }
+
+    bool sendPacket(GdbConnection& connection, const std::string& data)
+    {
+        unsigned char checksum = 0;
+        for(char c : data)
+        {
+            checksum += (unsigned char)c;
+        }
+        std::string packet = "$" + data + "#" + hexByte(checksum);
+
+        while(true)
+        {
+            if(!sendRaw(connection, packet))
+            {
+                return false;
+            }
+            if(connection.noAck)
+            {
+                return true;
+            }
+
+            char c;
+            do
+            {
+                if(!readByte(connection, c))
+                {
+                    return false;
+                }
+            } while(c != '+' && c != '-');
+
+            if(c == '+')
+            {
+                return true;
+            }
+        }
+    }
+
+    bool receivePacket(GdbConnection& connection, std::string& packet)
+    {
+        //Returns "\x03" for an out-of-band interrupt request
+
+        char c;
+        do
+        {
+            if(!readByte(connection, c))
+            {
+                return false;
+            }
+            if(c == 0x03)
+            {
+                packet = "\x03";
+                return true;
+            }
+        } while(c != '$');
+
+        packet.clear();
+        unsigned char checksum = 0;
+        while(true)
+        {
+            if(!readByte(connection, c))
+            {
+                return false;
+            }
+            if(c == '#')
+            {
+                break;
+            }
+            packet += c;
+            checksum += (unsigned char)c;
+        }
+
+        char high, low;
+        if(!readByte(connection, high) || !readByte(connection, low))
+        {
+            return false;
+        }
+
+        if(!connection.noAck)
+        {
+            bool valid = ((hexValue(high) << 4) | hexValue(low)) == checksum;
+            if(!sendRaw(connection, valid ? "+" : "-"))
+            {
+                return false;
+            }
+            if(!valid)
+            {
+                return receivePacket(connection, packet);
+            }
+        }
+
+        return true;
+    }
+
+    bool interruptRequested(GdbConnection& connection)
+    {
+        if(connection.bufferStart == connection.bufferEnd)
+        {
+            pollfd pfd = { connection.fd, POLLIN, 0 };
+            if(poll(&pfd, 1, 0) <= 0)
+            {
+                return false;
+            }
+        }
+
+        char c;
+        return readByte(connection, c) && c == 0x03;
+    }
+
+    bool listenAndAccept(const std::string& address, int& clientFd)
+    {
+        int serverFd;
+
+        if(address.compare(0, 5, "unix:") == 0)
+        {
+            std::string path = address.substr(5);
+            sockaddr_un addr = { };
+            addr.sun_family = AF_UNIX;
+            if(path.size() >= sizeof(addr.sun_path))
+            {
+                std::cout << "GDB socket path \"" << path << "\" is too long" << std::endl;
+                return false;
+            }
+            std::strcpy(addr.sun_path, path.c_str());
+            unlink(path.c_str());
+
+            serverFd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if(serverFd == -1 || bind(serverFd, (sockaddr*)&addr, sizeof(addr)) != 0)
+            {
+                std::cout << "Could not listen on \"" << path << "\"" << std::endl;
+                return false;
+            }
+        }
+        else
+        {
+            sockaddr_in addr = { };
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(std::atoi(address.c_str()));
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+            int reuse = 1;
+            serverFd = socket(AF_INET, SOCK_STREAM, 0);
+            if(serverFd != -1)
+            {
+                setsockopt(serverFd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+            }
+            if(serverFd == -1 || bind(serverFd, (sockaddr*)&addr, sizeof(addr)) != 0)
+            {
+                std::cout << "Could not listen on 127.0.0.1:" << address << std::endl;
+                return false;
+            }
+        }
+
+        listen(serverFd, 1);
+        std::cout << "Waiting for GDB on " << address << std::endl;
+        clientFd = accept(serverFd, nullptr, nullptr);
+        close(serverFd);
+
+        if(clientFd == -1)
+        {
+            return false;
+        }
+
+        int noDelay = 1;
+        setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay)); //fails harmlessly on Unix sockets
+        return true;
+    }
+
+    class GdbSession
+    {
+        public:
+
+            GdbSession(MIPS32_Simulator& simulator, int fd) : simulator(simulator)
+            {
+                connection.fd = fd;
+                connection.noAck = false;
+                connection.bufferStart = 0;
+                connection.bufferEnd = 0;
+            }
+
+            bool serve()
+            {
+                //Returns true if the debugger detached, false if it killed the session or disconnected
+
+                std::string packet;
+                while(receivePacket(connection, packet))
+                {
+                    if(packet == "\x03")
+                    {
+                        continue; //not running, nothing to interrupt
+                    }
+
+                    //an empty packet ("$#00") has no command and gets the empty unsupported reply below
+                    char command = packet.empty() ? '\0' : packet[0];
+                    std::string args = packet.empty() ? "" : packet.substr(1);
+                    std::string reply;
+
+                    if(command == 'k')
+                    {
+                        return false;
+                    }
+                    else if(command == 'D')
+                    {
+                        sendPacket(connection, "OK");
+                        return true;
+                    }
+                    else if(command == '?')
+                    {
+                        reply = simulator.isFinished() ? "W00" : "S05";
+                    }
+                    else if(command == 'c')
+                    {
+                        reply = resume(-1);
+                    }
+                    else if(command == 's')
+                    {
+                        reply = resume(1);
+                    }
+                    else if(command == 'g')
+                    {
+                        for(int r = 0; r < GDB_REGISTER_COUNT; r++)
+                        {
+                            reply += hexWord(readRegister(r));
+                        }
+                    }
+                    else if(command == 'G')
+                    {
+                        for(int r = 0; r < 32 && (r + 1) * 8 <= args.size(); r++)
+                        {
+                            simulator.setRegister(r, parseWord(args, r * 8));
+                        }
+                        reply = "OK";
+                    }
+                    else if(command == 'p')
+                    {
+                        int r = std::strtol(args.c_str(), nullptr, 16);
+                        reply = r < GDB_REGISTER_COUNT ? hexWord(readRegister(r)) : "xxxxxxxx";
+                    }
+                    else if(command == 'P')
+                    {
+                        int equals = args.find('=');
+                        int r = std::strtol(args.c_str(), nullptr, 16);
+                        if(equals != -1 && r < 32)
+                        {
+                            simulator.setRegister(r, parseWord(args, equals + 1));
+                        }
+                        reply = "OK"; //special registers are read-only and silently ignored
+                    }
+                    else if(command == 'm')
+                    {
+                        reply = readMemory(args);
+                    }
+                    else if(command == 'M')
+                    {
+                        reply = writeMemory(args);
+                    }
+                    else if(command == 'Z' || command == 'z')
+                    {
+                        reply = setPoint(command == 'Z', args);
+                    }
+                    else if(command == 'H' || command == 'T')
+                    {
+                        reply = "OK"; //single thread
+                    }
+                    else if(packet.compare(0, 10, "qSupported") == 0)
+                    {
+                        reply = "PacketSize=4000;QStartNoAckMode+";
+                    }
+                    else if(packet == "QStartNoAckMode")
+                    {
+                        sendPacket(connection, "OK");
+                        connection.noAck = true;
+                        continue;
+                    }
+                    else if(packet == "qAttached")
+                    {
+                        reply = "1";
+                    }
+                    else if(packet == "qC")
+                    {
+                        reply = "QC1";
+                    }
+                    else if(packet == "qfThreadInfo")
+                    {
+                        reply = "m1";
+                    }
+                    else if(packet == "qsThreadInfo")
+                    {
+                        reply = "l";
+                    }
+                    else if(packet == "qOffsets")
+                    {
+                        reply = "Text=0;Data=0;Bss=0";
+                    }
+                    //anything else is unsupported and answered with an empty packet
+
+                    if(!sendPacket(connection, reply))
+                    {
+                        return false;
+                    }
+                }
+
+                return false;
+            }
+
+        private:
+
+            MIPS32_Simulator& simulator;
+            GdbConnection connection;
+            std::map<int, int> watchTypes; //memory word -> WATCH_TYPE bits set through Z2/Z3/Z4
+
+            unsigned int readRegister(int r)
+            {
+                if(r < 32)
+                {
+                    return simulator.getRegister(r);
+                }
+                if(r == GDB_PC_REGISTER)
+                {
+                    return GDB_TEXT_BASE + 4 * std::max(simulator.getPc(), 0);
+                }
+                return 0; //sr, lo, hi, bad, cause are not modelled
+            }
+
+            std::string resume(long long cycles)
+            {
+                //cycles < 0 continues until a breakpoint, a watchpoint, the end or an interrupt from GDB
+
+                if(simulator.isFinished())
+                {
+                    return "W00";
+                }
+
+                if(cycles > 0)
+                {
+                    simulator.step(cycles);
+                }
+                else
+                {
+                    while(simulator.step(CYCLES_BETWEEN_INTERRUPT_CHECKS) && simulator.getStopReason() == MIPS32_Simulator::STOP_NONE)
+                    {
+                        if(interruptRequested(connection))
+                        {
+                            return "S02";
+                        }
+                    }
+                }
+
+                switch(simulator.getStopReason())
+                {
+                    case MIPS32_Simulator::STOP_WATCH_READ:
+                    case MIPS32_Simulator::STOP_WATCH_WRITE:
+                    {
+                        int word = simulator.getStopAddress();
+                        const char* kind = watchTypes[word] == MIPS32_Simulator::WATCH_ACCESS ? "awatch"
+                                           : simulator.getStopReason() == MIPS32_Simulator::STOP_WATCH_READ ? "rwatch" : "watch";
+                        char address[16];
+                        std::snprintf(address, sizeof(address), "%x", GDB_DATA_BASE + 4 * word);
+                        return std::string("T05") + kind + ":" + address + ";";
+                    }
+                    case MIPS32_Simulator::STOP_BREAKPOINT:
+                    case MIPS32_Simulator::STOP_WATCH_REGISTER:
+                        return "S05";
+                    default:
+                        return simulator.isFinished() ? "W00" : "S05";
+                }
+            }
+
+            bool parseRange(const std::string& args, unsigned int& addr, unsigned int& length)
+            {
+                char* end;
+                addr = std::strtoul(args.c_str(), &end, 16);
+                if(*end != ',')
+                {
+                    return false;
+                }
+                length = std::strtoul(end + 1, nullptr, 16);
+                return true;
+            }
+
+            bool readByteAt(unsigned int addr, unsigned int& value)
+            {
+                if(addr >= GDB_DATA_BASE && (addr - GDB_DATA_BASE) / 4 < simulator.getMemorySize())
+                {
+                    unsigned int word = simulator.readMemory((addr - GDB_DATA_BASE) / 4);
+                    value = (word >> (24 - 8 * ((addr - GDB_DATA_BASE) % 4))) & 0xff;
+                    return true;
+                }
+                if(addr >= GDB_TEXT_BASE && (addr - GDB_TEXT_BASE) / 4 < simulator.getInstructionCount())
+                {
+                    value = 0; //instructions are kept as text, so the text segment reads as nops
+                    return true;
+                }
+                return false;
+            }
+
+            std::string readMemory(const std::string& args)
+            {
+                unsigned int addr, length;
+                if(!parseRange(args, addr, length))
+                {
+                    return "E01";
+                }
+
+                std::string reply;
+                for(unsigned int i = 0; i < length; i++)
+                {
+                    unsigned int value;
+                    if(!readByteAt(addr + i, value))
+                    {
+                        break;
+                    }
+                    reply += hexByte(value);
+                }
+                return reply.empty() && length > 0 ? "E14" : reply;
+            }
+
+            std::string writeMemory(const std::string& args)
+            {
+                unsigned int addr, length;
+                int colon = args.find(':');
+                if(colon == -1 || !parseRange(args.substr(0, colon), addr, length) || args.size() < colon + 1 + 2 * length)
+                {
+                    return "E01";
+                }
+
+                for(unsigned int i = 0; i < length; i++)
+                {
+                    unsigned int a = addr + i;
+                    if(a < GDB_DATA_BASE || (a - GDB_DATA_BASE) / 4 >= simulator.getMemorySize())
+                    {
+                        return "E14";
+                    }
+
+                    int word = (a - GDB_DATA_BASE) / 4;
+                    int shift = 24 - 8 * ((a - GDB_DATA_BASE) % 4);
+                    unsigned int b = (hexValue(args[colon + 1 + 2 * i]) << 4) | hexValue(args[colon + 2 + 2 * i]);
+                    unsigned int value = simulator.readMemory(word);
+                    value = (value & ~(0xffu << shift)) | (b << shift);
+                    simulator.writeMemory(word, value);
+                }
+                return "OK";
+            }
+
+            std::string setPoint(bool insert, const std::string& args)
+            {
+                //Z0/Z1 breakpoints, Z2 write, Z3 read and Z4 access watchpoints
+
+                int type = args[0] - '0';
+                unsigned int addr, length;
+                if(args.size() < 3 || !parseRange(args.substr(2), addr, length))
+                {
+                    return "E01";
+                }
+
+                if(type == 0 || type == 1)
+                {
+                    if(addr < GDB_TEXT_BASE || (addr - GDB_TEXT_BASE) / 4 >= simulator.getInstructionCount())
+                    {
+                        return "E01";
+                    }
+                    int pc = (addr - GDB_TEXT_BASE) / 4;
+                    insert ? simulator.addBreakpoint(pc) : simulator.removeBreakpoint(pc);
+                    return "OK";
+                }
+
+                if(type >= 2 && type <= 4)
+                {
+                    int watchType = type == 2 ? MIPS32_Simulator::WATCH_WRITE : type == 3 ? MIPS32_Simulator::WATCH_READ : MIPS32_Simulator::WATCH_ACCESS;
+                    if(addr < GDB_DATA_BASE || (addr - GDB_DATA_BASE) / 4 >= simulator.getMemorySize())
+                    {
+                        return "E01";
+                    }
+
+                    unsigned int first = (addr - GDB_DATA_BASE) / 4;
+                    unsigned int last = (addr - GDB_DATA_BASE + std::max(length, 1u) - 1) / 4;
+                    for(unsigned int word = first; word <= last && word < simulator.getMemorySize(); word++)
+                    {
+                        if(insert)
+                        {
+                            simulator.addMemoryWatchpoint(word, watchType);
+                            watchTypes[word] |= watchType;
+                        }
+                        else
+                        {
+                            simulator.removeMemoryWatchpoint(word, watchType);
+                            watchTypes[word] &= ~watchType;
+                        }
+                    }
+                    return "OK";
+                }
+
+                return ""; //unsupported type
+            }
+    };
+}
+
+bool runGdbServer(MIPS32_Simulator& simulator, std::string address)
+{
+    int fd;
+    if(!listenAndAccept(address, fd))
+    {
+        return false;
+    }
+
+    GdbSession session(simulator, fd);
+    bool detached = session.serve();
+    close(fd);
+
+    if(detached)
+    {
+        simulator.executeInstructions();
+    }
+    return true;
+}
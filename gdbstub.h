@@ -0,0 +1,17 @@
+#ifndef GDBSTUB_H
+#define GDBSTUB_H
+
+#include <string>
+#include "simulator.h"
+
+//GDB remote serial protocol server for one debugger connection.
+//address is a TCP port on 127.0.0.1 ("1234") or a Unix socket path ("unix:/tmp/sim.sock").
+//Instruction index i is presented as address GDB_TEXT_BASE + 4 * i and memory word w as GDB_DATA_BASE + 4 * w,
+//registers and memory are big-endian (gdb-multiarch: "set architecture mips", "set endian big").
+//Returns when the debugger detaches (the program then runs to completion) or kills the session
+const unsigned int GDB_TEXT_BASE = 0x00400000;
+const unsigned int GDB_DATA_BASE = 0x10010000;
+
+bool runGdbServer(MIPS32_Simulator& simulator, std::string address);
+
+#endif
@@ -0,0 +1,159 @@
+#ifdef HOST_PROFILE
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include "hostprofile.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_PROFILE_RDTSC
+#endif
+
+namespace
+{
+    const int HISTOGRAM_BUCKETS = 64; //bucket b counts samples in [2^(b-1), 2^b) ticks
+
+    const char* STAGE_NAMES[HOST_STAGE_COUNT] =
+    {
+        "fetch", "decode", "execute", "memoryAccess", "writeBack", "debugPrint",
+        "simulate", "readInputFile", "processDataSeg", "processTextSeg"
+    };
+
+    struct StageProfile
+    {
+        unsigned long long calls = 0;
+        unsigned long long ticks = 0;
+        unsigned long long histogram[HISTOGRAM_BUCKETS] = { };
+    };
+
+    StageProfile stages[HOST_STAGE_COUNT];
+
+    //reference points used to convert ticks to nanoseconds
+    const unsigned long long startTicks = hostProfileNow();
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    double ticksPerNanosecond()
+    {
+#ifdef HOST_PROFILE_RDTSC
+        double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - startTime).count();
+        return elapsed > 0 ? (hostProfileNow() - startTicks) / elapsed : 1.0;
+#else
+        return 1.0;
+#endif
+    }
+
+    int bucketOf(unsigned long long ticks)
+    {
+        int bucket = 0;
+        while(ticks > 0 && bucket < HISTOGRAM_BUCKETS - 1)
+        {
+            ticks >>= 1;
+            bucket++;
+        }
+        return bucket;
+    }
+
+    unsigned long long percentile(const StageProfile& stage, double fraction)
+    {
+        //upper bound of the histogram bucket holding the requested fraction of samples
+        unsigned long long target = stage.calls * fraction, seen = 0;
+        for(int b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+            seen += stage.histogram[b];
+            if(seen > target)
+            {
+                return b == 0 ? 0 : 1ULL << b;
+            }
+        }
+        return 0;
+    }
+}
+
+unsigned long long hostProfileNow()
+{
+#ifdef HOST_PROFILE_RDTSC
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void hostProfileRecord(HOST_PROFILE_STAGE stage, unsigned long long ticks)
+{
+    //ticks are converted to nanoseconds in the report, once the tick rate has been calibrated over the whole run
+    StageProfile& profile = stages[stage];
+    profile.calls++;
+    profile.ticks += ticks;
+    profile.histogram[bucketOf(ticks)]++;
+}
+
+void hostProfileReport(std::ostream& out, long long cycles, long long instructions)
+{
+    double rate = ticksPerNanosecond();
+
+    out << "-------------------------Host Profile-------------------------" << std::endl;
+    //every column is followed by a space so a value wider than its column still stays apart from the next one
+    out << std::left << std::setw(21) << "stage" << ' ' << std::setw(11) << "calls" << ' ' << std::setw(13) << "total ms" << ' '
+        << std::setw(13) << "ns/call" << ' ' << std::setw(13) << "p50 ns" << ' ' << std::setw(13) << "p99 ns" << ' '
+        << std::setw(13) << "ns/cycle" << ' ' << "ns/instr" << std::endl;
+    out << std::fixed << std::setprecision(2);
+
+    for(int s = 0; s < HOST_STAGE_COUNT; s++)
+    {
+        const StageProfile& stage = stages[s];
+        if(stage.calls == 0)
+        {
+            continue;
+        }
+
+        double ns = stage.ticks / rate;
+        out << std::setw(21) << STAGE_NAMES[s] << ' ' << std::setw(11) << stage.calls << ' ' << std::setw(13) << ns / 1000000.0 << ' '
+            << std::setw(13) << ns / stage.calls << ' '
+            << std::setw(13) << percentile(stage, 0.5) / rate << ' ' << std::setw(13) << percentile(stage, 0.99) / rate << ' '
+            << std::setw(13) << (cycles > 0 ? ns / cycles : 0.0) << ' ' << (instructions > 0 ? ns / instructions : 0.0) << std::endl;
+    }
+
+    out << std::defaultfloat;
+}
+
+bool hostProfileWriteJson(std::string fileName, long long cycles, long long instructions)
+{
+    //One JSON object per run, appended so a dashboard can collect a history from a single file
+
+    std::ofstream outFile(fileName, std::ios::app);
+    if(!outFile.is_open())
+    {
+        std::cout << "Host profile file \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+
+    double rate = ticksPerNanosecond();
+
+    outFile << "{\"cycles\":" << cycles << ",\"instructions\":" << instructions << ",\"stages\":{";
+    bool first = true;
+    for(int s = 0; s < HOST_STAGE_COUNT; s++)
+    {
+        const StageProfile& stage = stages[s];
+        double ns = stage.ticks / rate;
+
+        outFile << (first ? "" : ",") << "\"" << STAGE_NAMES[s] << "\":{\"calls\":" << stage.calls
+                << ",\"total_ns\":" << (unsigned long long)ns
+                << ",\"ns_per_cycle\":" << (cycles > 0 ? ns / cycles : 0.0)
+                << ",\"ns_per_instruction\":" << (instructions > 0 ? ns / instructions : 0.0)
+                << ",\"histogram_ticks_log2\":[";
+        for(int b = 0; b < HISTOGRAM_BUCKETS; b++)
+        {
+            outFile << (b == 0 ? "" : ",") << stage.histogram[b];
+        }
+        outFile << "]}";
+        first = false;
+    }
+    outFile << "},\"ticks_per_ns\":" << rate << "}" << std::endl;
+
+    return true;
+}
+
+#endif
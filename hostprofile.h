@@ -0,0 +1,59 @@
+#ifndef HOSTPROFILE_H
+#define HOSTPROFILE_H
+
+//Host-side self-profiling of the simulator: how much real time each stage function and loader phase takes.
+//Only compiled in when HOST_PROFILE is defined ("make HOST_PROFILE=1"), otherwise every macro expands to nothing
+
+#ifdef HOST_PROFILE
+
+#include <string>
+#include <ostream>
+
+enum HOST_PROFILE_STAGE
+{
+    HOST_FETCH,
+    HOST_DECODE,
+    HOST_EXECUTE,
+    HOST_MEMORYACCESS,
+    HOST_WRITEBACK,
+    HOST_DEBUGPRINT,
+    HOST_SIMULATE, //whole of executeInstructions, run, step and runUntil*, including the pipeline queue
+    HOST_READINPUT,
+    HOST_DATASEG,
+    HOST_TEXTSEG,
+    HOST_STAGE_COUNT
+};
+
+unsigned long long hostProfileNow(); //rdtsc ticks on x86, steady_clock nanoseconds elsewhere
+
+void hostProfileRecord(HOST_PROFILE_STAGE stage, unsigned long long ticks);
+
+void hostProfileReport(std::ostream& out, long long cycles, long long instructions);
+
+bool hostProfileWriteJson(std::string fileName, long long cycles, long long instructions);
+
+class HostProfileScope
+{
+    public:
+
+        HostProfileScope(HOST_PROFILE_STAGE stage) : stage(stage), start(hostProfileNow()) { }
+
+        ~HostProfileScope() { hostProfileRecord(stage, hostProfileNow() - start); }
+
+    private:
+
+        HOST_PROFILE_STAGE stage;
+        unsigned long long start;
+};
+
+#define HOST_PROFILE_CONCAT2(a, b) a##b
+#define HOST_PROFILE_CONCAT(a, b) HOST_PROFILE_CONCAT2(a, b)
+#define HOST_PROFILE_SCOPE(stage) HostProfileScope HOST_PROFILE_CONCAT(hostProfileScope, __LINE__)(stage)
+
+#else
+
+#define HOST_PROFILE_SCOPE(stage)
+
+#endif
+
+#endif
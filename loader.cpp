@@ -0,0 +1,442 @@
+#include <vector>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include <stdexcept>
+#include "loader.h"
+#include "hostprofile.h"
+
+bool readInputFile(std::vector<std::string>& contents, std::string fileName, std::string& error)
+{
+    HOST_PROFILE_SCOPE(HOST_READINPUT);
+
+    std::ifstream inFile(fileName);
+
+    if(inFile.is_open())
+    {
+        std::string s;
+        while(std::getline(inFile, s))
+        {
+            contents.push_back(s);
+        }
+    }
+    else
+    {
+        error = "Input file \"" + fileName + "\" could not be opened";
+        return false;
+    }
+
+    inFile.close();
+    return true;
+}
+
+bool processDataSeg(std::vector<std::string>& instructions, std::vector<int>& memory, std::unordered_map<std::string, int>& dataLabels, std::string& error)
+{
+    HOST_PROFILE_SCOPE(HOST_DATASEG);
+
+    //Read data segment from instructions, allocate memory as needed and add label/index mapping to dataLabels
+    //Removes data segment from instructions when finished
+
+    std::vector<std::string> dataSeg;
+    bool inDataSeg = false;
+    std::vector<std::string>::iterator i;
+
+    for(i = instructions.begin(); i != instructions.end(); i++)
+    {
+        if(inDataSeg)
+        {
+            if(*i == ".text")
+            {
+                break; //data segment finished
+            }
+            if(i->length() > 0)
+            {
+                dataSeg.push_back(*i);
+            }
+        }
+        else
+        {
+            if(*i == ".data")
+            {
+                inDataSeg = true; //data segment started
+            }
+        }
+    }
+
+    if(i == instructions.end())
+    {
+        error = std::string("Input is missing the ") + (inDataSeg ? ".text" : ".data") + " section";
+        return false;
+    }
+
+    instructions.erase(instructions.begin(), i + 1); //only keep text segment here
+
+    for(std::string line : dataSeg)
+    {
+        //assuming only words in data segment for now
+        std::istringstream stringStream(line);
+        std::string tag, instr, value;
+        stringStream >> tag >> instr >> value;
+
+        size_t parsed = 0;
+        int init_val = 0;
+        try
+        {
+            init_val = std::stoi(value, &parsed);
+        }
+        catch(const std::exception&)
+        {
+        }
+        if(parsed == 0) //no number where the word's value should be
+        {
+            error = "Invalid data segment line \"" + line + "\"";
+            return false;
+        }
+
+        tag = tag.substr(0, tag.length() - 1); //remove colon
+
+        memory.push_back(init_val); //allocate word of memory with initial value
+        dataLabels.emplace(tag, memory.size() - 1); //add label and index mapping to dataLabels
+    }
+
+    return true;
+}
+
+void processTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels)
+{
+    HOST_PROFILE_SCOPE(HOST_TEXTSEG);
+
+    //Look for labels in instructions and map them with line numbers in textLabels
+    //Cleans up text segment for easier processing (remove labels, blank lines, etc)
+
+    std::vector<std::string> newInstructions;
+
+    //first pass to remove empty lines
+    for(std::string s : instructions)
+    {
+        if(s.length() > 0 && s[0] != '#') //not blank line or comments
+        {
+            newInstructions.push_back(s);
+        }
+    }
+
+    //second pass to handle and remove labels
+    for(int i = 0; i < newInstructions.size(); i++)
+    {
+        int labelEnd = newInstructions[i].find(':');
+
+        if(labelEnd != -1) //line has a label
+        {
+            std::string label;
+            label = newInstructions[i].substr(0, labelEnd);
+
+            textLabels.emplace(label, i); //save index of label
+
+            newInstructions[i] = newInstructions[i].substr(labelEnd + 1); //remove label from instruction
+        }
+    }
+
+    instructions.clear();
+    for(auto i = newInstructions.begin(); i != newInstructions.end(); i++)
+    {
+        instructions.push_back(*i);
+    }
+}
+
+namespace
+{
+    const std::unordered_map<std::string, int> REGISTER_NAMES
+    {
+        { "$zero", 0 }, { "$at", 1 }, { "$v0", 2 }, { "$v1", 3 },
+        { "$a0", 4 }, { "$a1", 5 }, { "$a2", 6 }, { "$a3", 7 },
+        { "$t0", 8 }, { "$t1", 9 }, { "$t2", 10 }, { "$t3", 11 },
+        { "$t4", 12 }, { "$t5", 13 }, { "$t6", 14 }, { "$t7", 15 },
+        { "$s0", 16 }, { "$s1", 17 }, { "$s2", 18 }, { "$s3", 19 },
+        { "$s4", 20 }, { "$s5", 21 }, { "$s6", 22 }, { "$s7", 23 },
+        { "$t8", 24 }, { "$t9", 25 }, { "$k0", 26 }, { "$k1", 27 },
+        { "$gp", 28 }, { "$sp", 29 }, { "$fp", 30 }, { "$ra", 31 }
+    };
+
+    bool parseImmediate(const std::string& text, int& value)
+    {
+        size_t parsed = 0;
+        try
+        {
+            value = std::stoi(text, &parsed);
+        }
+        catch(const std::exception&)
+        {
+            return false;
+        }
+        return parsed == text.length();
+    }
+
+    //Operand list of one instruction, split on whitespace like the original decoder did
+    struct OperandReader
+    {
+        std::vector<std::string> operands;
+        int next = 0;
+        std::string error;
+
+        //every operand but the last one of the instruction ends with a comma, which is removed here
+        bool take(std::string& operand, bool last)
+        {
+            if(next == operands.size())
+            {
+                error = "missing operand";
+                return false;
+            }
+            operand = operands[next++];
+            if(!last)
+            {
+                if(operand.length() < 2 || operand.back() != ',')
+                {
+                    error = "expected a comma after \"" + operand + "\"";
+                    return false;
+                }
+                operand.pop_back();
+            }
+            return true;
+        }
+
+        bool takeRegister(int& index, bool last)
+        {
+            std::string name;
+            if(!take(name, last))
+            {
+                return false;
+            }
+            index = registerIndex(name);
+            if(index == -1)
+            {
+                error = "unknown register \"" + name + "\"";
+                return false;
+            }
+            return true;
+        }
+
+        bool takeImmediate(int& value)
+        {
+            std::string text;
+            if(!take(text, true))
+            {
+                return false;
+            }
+            if(!parseImmediate(text, value))
+            {
+                error = "invalid immediate \"" + text + "\"";
+                return false;
+            }
+            return true;
+        }
+
+        bool takeLabel(const std::unordered_map<std::string, int>& labels, int& index)
+        {
+            std::string label;
+            if(!take(label, true))
+            {
+                return false;
+            }
+            auto found = labels.find(label);
+            if(found == labels.end())
+            {
+                error = "unknown label \"" + label + "\"";
+                return false;
+            }
+            index = found->second;
+            return true;
+        }
+
+        //anything after the operands has to be a comment
+        bool finish()
+        {
+            if(next < operands.size() && operands[next][0] != '#')
+            {
+                error = "unexpected \"" + operands[next] + "\"";
+                return false;
+            }
+            return true;
+        }
+    };
+}
+
+int registerIndex(const std::string& name)
+{
+    auto found = REGISTER_NAMES.find(name);
+    return found == REGISTER_NAMES.end() ? -1 : found->second;
+}
+
+bool decodeInstruction(const std::string& line, const std::unordered_map<std::string, int>& dataLabels, const std::unordered_map<std::string, int>& textLabels, DecodedInstruction& decoded, std::string& error)
+{
+    decoded = DecodedInstruction();
+
+    std::istringstream stringStream(line);
+    std::string mnemonic, operand;
+    stringStream >> mnemonic;
+
+    OperandReader reader;
+    while(stringStream >> operand)
+    {
+        reader.operands.push_back(operand);
+    }
+
+    if(mnemonic.empty() || mnemonic[0] == '#') //blank line or a label on its own
+    {
+        return true;
+    }
+
+    int op = 0;
+    while(op < OPCODE_COUNT && mnemonic != OPCODE_NAMES[op])
+    {
+        op++;
+    }
+    if(op == OPCODE_COUNT)
+    {
+        error = "unknown instruction \"" + mnemonic + "\"";
+        return false;
+    }
+    decoded.opcode = op;
+
+    bool ok = true;
+    switch(op)
+    {
+        case OP_ADD: case OP_SUB: case OP_MULT: case OP_AND: case OP_OR: case OP_SLL: case OP_SRL:
+        {
+            //rd, rs, rt or rd, rs, constant
+            ok = reader.takeRegister(decoded.rd, false) && reader.takeRegister(decoded.rs, false);
+            if(ok && reader.next < reader.operands.size() && reader.operands[reader.next][0] == '$')
+            {
+                ok = reader.takeRegister(decoded.rt, true);
+            }
+            else if(ok)
+            {
+                decoded.immOperand = true;
+                ok = reader.takeImmediate(decoded.imm);
+                if(ok && (op == OP_SLL || op == OP_SRL) && (decoded.imm < 0 || decoded.imm > 31))
+                {
+                    reader.error = "shift amount " + std::to_string(decoded.imm) + " is not between 0 and 31";
+                    ok = false;
+                }
+            }
+            break;
+        }
+        case OP_ADDI:
+            ok = reader.takeRegister(decoded.rd, false) && reader.takeRegister(decoded.rs, false) && reader.takeImmediate(decoded.imm);
+            break;
+        case OP_LI:
+            ok = reader.takeRegister(decoded.rd, false) && reader.takeImmediate(decoded.imm);
+            break;
+        case OP_LA:
+            ok = reader.takeRegister(decoded.rd, false) && reader.takeLabel(dataLabels, decoded.imm);
+            break;
+        case OP_LW: case OP_SW:
+        {
+            //register, offset(base)
+            ok = reader.takeRegister(op == OP_LW ? decoded.rd : decoded.rt, false) && reader.take(operand, true);
+            if(ok)
+            {
+                int open = operand.find('(');
+                if(open == -1 || operand.back() != ')' || !parseImmediate(operand.substr(0, open), decoded.imm))
+                {
+                    reader.error = "expected offset($register) instead of \"" + operand + "\"";
+                    ok = false;
+                }
+                else
+                {
+                    std::string base = operand.substr(open + 1, operand.length() - open - 2);
+                    decoded.rs = registerIndex(base);
+                    if(decoded.rs == -1)
+                    {
+                        reader.error = "unknown register \"" + base + "\"";
+                        ok = false;
+                    }
+                }
+            }
+            break;
+        }
+        case OP_BEQ:
+            ok = reader.takeRegister(decoded.rs, false) && reader.takeRegister(decoded.rt, false) && reader.takeLabel(textLabels, decoded.imm);
+            break;
+        case OP_J:
+            ok = reader.takeLabel(textLabels, decoded.imm);
+            break;
+    }
+
+    if(!ok || !reader.finish())
+    {
+        error = reader.error;
+        return false;
+    }
+    return true;
+}
+
+bool decodeTextSeg(const std::vector<std::string>& instructions, const std::unordered_map<std::string, int>& dataLabels, const std::unordered_map<std::string, int>& textLabels, std::vector<DecodedInstruction>& decoded, std::string& error)
+{
+    decoded.resize(instructions.size());
+    for(int i = 0; i < instructions.size(); i++)
+    {
+        if(!decodeInstruction(instructions[i], dataLabels, textLabels, decoded[i], error))
+        {
+            error = "Invalid instruction " + std::to_string(i) + " \"" + instructions[i] + "\": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool readInputBuffer(std::vector<std::string>& contents, const char* buffer, size_t size)
+{
+    std::istringstream inStream(std::string(buffer, size));
+
+    std::string s;
+    while(std::getline(inStream, s))
+    {
+        contents.push_back(s);
+    }
+
+    return true;
+}
+
+bool loadProgram(const char* buffer, size_t size, Program& program, std::string& error)
+{
+    program = Program();
+
+    readInputBuffer(program.instructions, buffer, size);
+    if(!processDataSeg(program.instructions, program.mainMemory, program.dataLabels, error))
+    {
+        program = Program();
+        return false;
+    }
+    processTextSeg(program.instructions, program.textLabels);
+    if(!decodeTextSeg(program.instructions, program.dataLabels, program.textLabels, program.decoded, error))
+    {
+        program = Program();
+        return false;
+    }
+
+    return true;
+}
+
+bool loadProgramFile(std::string fileName, Program& program, std::string& error)
+{
+    program = Program();
+
+    if(!readInputFile(program.instructions, fileName, error))
+    {
+        return false;
+    }
+    if(!processDataSeg(program.instructions, program.mainMemory, program.dataLabels, error))
+    {
+        program = Program();
+        return false;
+    }
+    processTextSeg(program.instructions, program.textLabels);
+    if(!decodeTextSeg(program.instructions, program.dataLabels, program.textLabels, program.decoded, error))
+    {
+        program = Program();
+        return false;
+    }
+
+    return true;
+}
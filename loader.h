@@ -0,0 +1,58 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "timing.h"
+
+//Bump whenever the loader's parsing or the Program layout changes, so cached programs are invalidated
+#define SIMULATOR_VERSION "2.2"
+
+//One text segment line with its register names and labels resolved
+struct DecodedInstruction
+{
+    int opcode = OP_NOP; //OP_NOP for blank lines
+    int rd = 0; //register written, the loaded register for lw
+    int rs = 0; //first register read, the address base for lw and sw
+    int rt = 0; //second register read, the stored register for sw
+    int imm = 0; //immediate, memory offset, shift amount, data address (la) or instruction index (beq, j)
+    bool immOperand = false; //R-type whose last operand is a constant instead of rt
+};
+
+//A parsed program, ready to be handed to MIPS32_Simulator
+struct Program
+{
+    std::vector<std::string> instructions; //text segment, labels and blank lines removed
+    std::vector<DecodedInstruction> decoded; //one per instruction, what the simulator's ID stage reads
+    std::vector<int> mainMemory; //initial data segment
+    std::unordered_map<std::string, int> dataLabels;
+    std::unordered_map<std::string, int> textLabels;
+};
+
+//The functions below return false with a message in error instead of printing it
+
+bool readInputFile(std::vector<std::string>& contents, std::string fileName, std::string& error);
+
+bool readInputBuffer(std::vector<std::string>& contents, const char* buffer, size_t size);
+
+//Fails when the .data or .text section is missing or a data line has no numeric value
+bool processDataSeg(std::vector<std::string>& instructions, std::vector<int>& memory, std::unordered_map<std::string, int>& dataLabels, std::string& error);
+
+void processTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels);
+
+int registerIndex(const std::string& name); //-1 for anything but a register name such as "$t0"
+
+//Parses one text segment line, blank lines decode as nop. Fails for an unknown instruction, register or label,
+//a missing or extra operand, or an immediate that does not fit in an int
+bool decodeInstruction(const std::string& line, const std::unordered_map<std::string, int>& dataLabels, const std::unordered_map<std::string, int>& textLabels, DecodedInstruction& decoded, std::string& error);
+
+//decodeInstruction for every line of the text segment, the error names the first bad one
+bool decodeTextSeg(const std::vector<std::string>& instructions, const std::unordered_map<std::string, int>& dataLabels, const std::unordered_map<std::string, int>& textLabels, std::vector<DecodedInstruction>& decoded, std::string& error);
+
+//readInputFile/readInputBuffer followed by processDataSeg, processTextSeg and decodeTextSeg, false (and an empty program) on malformed input
+bool loadProgram(const char* buffer, size_t size, Program& program, std::string& error);
+
+bool loadProgramFile(std::string fileName, Program& program, std::string& error);
+
+#endif
@@ -4,157 +4,327 @@
 #include <string>
 #include <sstream>
 #include <unordered_map>
+#include <thread>
+#include <cstdlib>
+#include <stdexcept>
+#include <memory>
 #include "simulator.h"
-
-bool readInputFile(std::vector<std::string>& contents, std::string fileName);
-void processDataSeg(std::vector<std::string>& instructions, std::vector<int>& memory, std::unordered_map<std::string, int>& dataLabels);
-void processTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels);
+#include "loader.h"
+#include "sweep.h"
+#include "profiler.h"
+#include "hostprofile.h"
+#include "scheduler.h"
+#include "progcache.h"
+#include "gdbstub.h"
 
 int main(int argc, char** argv)
 {
-    std::vector<std::string> fileContents;
-    std::unordered_map<std::string, int> dataLabels;
-    std::unordered_map<std::string, int> textLabels;
-    std::vector<int> mainMemory;
+    Program program;
     bool debugMode = false;
+    TimingConfig timingConfig;
+    std::string sweepFile;
+    std::string profilePrefix;
+    std::string hostProfileFile;
+    bool scheduleMode = false;
+    bool verifySchedule = false;
+    int threadCount = std::thread::hardware_concurrency();
+    std::string cacheDir;
+    std::vector<std::string> breakpointArgs;
+    std::vector<std::string> watchpointArgs;
+    std::vector<std::string> registerWatchArgs;
+    std::string gdbAddress;
+    DumpOptions dumpOptions;
+    bool dumpChanged = false;
+    std::string imageFile;
+    bool hexImage = false;
+    std::string fileName;
+    std::string error;
 
-    if(argc > 1)
+    for(int i = 1; i < argc; i++)
     {
-        if(argc > 2)
+        std::string arg(argv[i]);
+
+        if(arg == "-d")
+        {
+            std::cout << "Debug Mode enabled" << std::endl;
+            debugMode = true;
+        }
+        else if(arg == "-c" && i + 1 < argc) //-c key=value sets one microarchitecture parameter
         {
-            if(std::string(argv[1]) == "-d")
+            std::string option(argv[++i]);
+            int equals = option.find('=');
+            if(equals == -1 || !timingConfig.set(option.substr(0, equals), option.substr(equals + 1), error))
             {
-                std::cout << "Debug Mode enabled" << std::endl;
-                debugMode = true;
-                argv[1] = argv[2];
+                if(!error.empty())
+                {
+                    std::cout << error << std::endl;
+                }
+                std::cout << "commands not recognized, please check the readme" << std::endl;
+                return 0;
             }
-            else
+        }
+        else if(arg == "-s" && i + 1 < argc) //-s grid.txt runs a design-space sweep
+        {
+            sweepFile = argv[++i];
+        }
+        else if(arg == "-O") //-O fills nop slots with the static scheduler
+        {
+            scheduleMode = true;
+        }
+        else if(arg == "-verify") //-verify compares the scheduled run against the unscheduled one
+        {
+            verifySchedule = true;
+        }
+        else if(arg == "-p" && i + 1 < argc) //-p prefix writes a per-instruction profile
+        {
+            profilePrefix = argv[++i];
+        }
+#ifdef HOST_PROFILE
+        else if(arg == "-H" && i + 1 < argc) //-H file appends the host profile as JSON
+        {
+            hostProfileFile = argv[++i];
+        }
+#endif
+        else if(arg == "-cache" && i + 1 < argc) //-cache dir reuses parsed programs between runs
+        {
+            cacheDir = argv[++i];
+        }
+        else if(arg == "-j" && i + 1 < argc) //-j n sets the number of sweep threads
+        {
+            threadCount = std::atoi(argv[++i]);
+        }
+        else if(arg == "-b" && i + 1 < argc) //-b label|index stops before that instruction executes
+        {
+            breakpointArgs.push_back(argv[++i]);
+        }
+        else if(arg == "-w" && i + 1 < argc) //-w label|index stops on any access to that memory word
+        {
+            watchpointArgs.push_back(argv[++i]);
+        }
+        else if(arg == "-rw" && i + 1 < argc) //-rw $reg stops when that register is written
+        {
+            registerWatchArgs.push_back(argv[++i]);
+        }
+        else if(arg == "-gdb" && i + 1 < argc) //-gdb port|unix:path waits for a GDB connection
+        {
+            gdbAddress = argv[++i];
+        }
+        else if(arg == "-range" && i + 1 < argc) //-range begin:end limits the memory dump and image, either side may be left out
+        {
+            std::string range(argv[++i]);
+            int colon = range.find(':');
+            if(colon == -1)
             {
                 std::cout << "commands not recognized, please check the readme" << std::endl;
                 return 0;
             }
+            dumpOptions.begin = colon > 0 ? std::atoi(range.substr(0, colon).c_str()) : 0;
+            dumpOptions.end = colon + 1 < range.length() ? std::atoi(range.substr(colon + 1).c_str()) : -1;
         }
-        if(readInputFile(fileContents, argv[1]))
+        else if(arg == "-nonzero") //-nonzero leaves zero words out of the memory dump
         {
-            processDataSeg(fileContents, mainMemory, dataLabels);
-            processTextSeg(fileContents, textLabels);
-
-            MIPS32_Simulator simulator(fileContents, mainMemory, dataLabels, textLabels, debugMode);
-
-            simulator.executeInstructions();
-            simulator.printRegisterContents();
-            simulator.printMemoryContents();
+            dumpOptions.nonZeroOnly = true;
+        }
+        else if(arg == "-changed") //-changed only dumps words the program modified
+        {
+            dumpChanged = true;
+        }
+        else if((arg == "-bin" || arg == "-hex") && i + 1 < argc) //-bin file or -hex file also writes a memory image
+        {
+            hexImage = (arg == "-hex");
+            imageFile = argv[++i];
+        }
+        else if(fileName.empty() && arg[0] != '-')
+        {
+            fileName = arg;
+        }
+        else
+        {
+            std::cout << "commands not recognized, please check the readme" << std::endl;
+            return 0;
         }
     }
 
-    return 0;
-}
-
-bool readInputFile(std::vector<std::string>& contents, std::string fileName)
-{
-    std::ifstream inFile(fileName);
-
-    if(inFile.is_open())
+    if(fileName.empty())
     {
-        std::string s;
-        while(std::getline(inFile, s))
-        {
-            contents.push_back(s);
-        }
+        return 0;
     }
-    else
+    if(!timingConfig.isValid(error))
+    {
+        std::cout << error << std::endl;
+        return 0;
+    }
+    if(timingConfig.branchStage == "id" && timingConfig.predictor == "perfect")
     {
-        std::cout << "Input file \"" << fileName << "\" could not be opened" << std::endl;
-        return false;
+        std::cout << "Note: branch.stage only changes the misprediction penalty, so it has no effect with predictor=perfect" << std::endl;
     }
 
-    inFile.close();
-    return true;
-}
+    if(cacheDir.empty() ? loadProgramFile(fileName, program, error) : loadProgramCached(fileName, cacheDir, program, error))
+    {
+        std::vector<std::string>& fileContents = program.instructions;
+        std::vector<int>& mainMemory = program.mainMemory;
+        std::unordered_map<std::string, int>& dataLabels = program.dataLabels;
+        std::unordered_map<std::string, int>& textLabels = program.textLabels;
 
-void processDataSeg(std::vector<std::string>& instructions, std::vector<int>& memory, std::unordered_map<std::string, int>& dataLabels)
-{
-    //Read data segment from instructions, allocate memory as needed and add label/index mapping to dataLabels
-    //Removes data segment from instructions when finished
+        std::vector<std::string> unscheduledContents(fileContents);
+        std::unordered_map<std::string, int> unscheduledLabels(textLabels);
+        ScheduleReport scheduleReport;
 
-    std::vector<std::string> dataSeg;
-    bool inDataSeg = false;
-    std::vector<std::string>::iterator i;
+        if(scheduleMode)
+        {
+            scheduleTextSeg(fileContents, textLabels, scheduleReport);
+            program.decoded.clear(); //the simulator decodes the scheduled text again
+        }
 
-    for(i = instructions.begin(); i != instructions.end(); i++)
-    {
-        if(inDataSeg)
+        if(!sweepFile.empty())
         {
-            if(*i == ".text")
+            SweepGrid grid;
+            std::vector<TimingConfig> configs;
+            if(!readSweepGrid(sweepFile, grid) || !expandSweepGrid(grid, timingConfig, configs))
             {
-                break; //data segment finished
+                return 0;
             }
-            if(i->length() > 0)
+
+            //run the program once and share its instruction stream between all configurations
+            std::vector<RetireRecord> trace;
+            MIPS32_Simulator simulator(program);
+            simulator.captureTrace(&trace);
+            simulator.executeInstructions();
+            if(!simulator.getError().empty())
             {
-                dataSeg.push_back(*i);
+                std::cout << simulator.getError() << std::endl;
+                return 0;
+            }
+
+            //the capture run uses the default timing, take its stalls out so each configuration only counts its own
+            runSweep(grid, configs, trace, simulator.getCycleCount() - simulator.getTimingStats().stallCycles, threadCount);
+            return 0;
+        }
+
+        MIPS32_Simulator simulator(program, debugMode, timingConfig);
+        std::unique_ptr<Profiler> profiler; //only built with -p, so a normal run pays nothing for it
+
+        if(!profilePrefix.empty())
+        {
+            profiler.reset(new Profiler(fileContents, textLabels));
+            simulator.attachProfiler(profiler.get());
+        }
+
+        for(const std::string& b : breakpointArgs)
+        {
+            int pc = textLabels.count(b) ? textLabels[b] : std::atoi(b.c_str());
+            if(pc < 0 || pc >= (int)fileContents.size())
+            {
+                std::cout << "Breakpoint \"" << b << "\" is not an instruction" << std::endl;
+                return 0;
+            }
+            simulator.addBreakpoint(pc);
+        }
+        for(const std::string& w : watchpointArgs)
+        {
+            int addr = dataLabels.count(w) ? dataLabels[w] : std::atoi(w.c_str());
+            if(addr < 0 || addr >= (int)mainMemory.size())
+            {
+                std::cout << "Watchpoint \"" << w << "\" is not a memory address" << std::endl;
+                return 0;
+            }
+            simulator.addMemoryWatchpoint(addr, MIPS32_Simulator::WATCH_ACCESS);
+        }
+        for(const std::string& r : registerWatchArgs)
+        {
+            int index = -1;
+            for(int j = 0; j < 32 && index == -1; j++)
+            {
+                if(r == "$" + std::to_string(j))
+                {
+                    index = j;
+                }
+            }
+            try
+            {
+                index = index == -1 ? simulator.getRegisterIndex(r) : index;
+            }
+            catch(const std::out_of_range&)
+            {
+                std::cout << "Register \"" << r << "\" does not exist" << std::endl;
+                return 0;
+            }
+            simulator.addRegisterWatchpoint(index);
+        }
+
+        if(!gdbAddress.empty())
+        {
+            if(!runGdbServer(simulator, gdbAddress))
+            {
+                return 0;
             }
         }
         else
         {
-            if(*i == ".data")
+            while(simulator.run())
             {
-                inDataSeg = true; //data segment started
+                const char* reasons[] = { "", "breakpoint", "read watchpoint", "write watchpoint", "register watchpoint" };
+                std::cout << "Stopped at " << reasons[simulator.getStopReason()] << " " << simulator.getStopAddress()
+                          << " (cycle " << simulator.getCycleCount() << ", pc " << simulator.getPc() << ": " << simulator.getInstruction(simulator.getPc()) << ")" << std::endl;
+                simulator.printRegisterContents();
             }
         }
-    }
+        if(!simulator.getError().empty())
+        {
+            std::cout << simulator.getError() << std::endl;
+        }
 
-    instructions.erase(instructions.begin(), i + 1); //only keep text segment here
+        dumpOptions.initial = dumpChanged ? &mainMemory : nullptr; //the simulator works on its own copy
+        simulator.printRegisterContents();
+        simulator.printMemoryContents(dumpOptions);
+        simulator.printStatistics();
 
-    for(std::string line : dataSeg)
-    {
-        //assuming only words in data segment for now
-        std::istringstream stringStream(line);
-        std::string tag, instr, value;
-        stringStream >> tag >> instr >> value;
+        if(!imageFile.empty())
+        {
+            writeMemoryImage(imageFile, simulator.getMainMemory(), dumpOptions.begin, dumpOptions.end, hexImage);
+        }
 
-        tag = tag.substr(0, tag.length() - 1); //remove colon
-        int init_val = std::stoi(value);
+#ifdef HOST_PROFILE
+        //reported before the -verify reference run, which would otherwise add to the stage counters
+        hostProfileReport(std::cout, simulator.getCycleCount(), simulator.getTimingStats().retired);
+        if(!hostProfileFile.empty())
+        {
+            hostProfileWriteJson(hostProfileFile, simulator.getCycleCount(), simulator.getTimingStats().retired);
+        }
+#endif
 
-        memory.push_back(init_val); //allocate word of memory with initial value
-        dataLabels.emplace(tag, memory.size() - 1); //add label and index mapping to dataLabels
-    }
-}
+        if(scheduleMode)
+        {
+            printScheduleReport(scheduleReport);
 
-void processTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels)
-{
-    //Look for labels in instructions and map them with line numbers in textLabels
-    //Cleans up text segment for easier processing (remove labels, blank lines, etc)
+            if(verifySchedule)
+            {
+                MIPS32_Simulator reference(unscheduledContents, mainMemory, dataLabels, unscheduledLabels, false, timingConfig);
+                reference.executeInstructions();
 
-    std::vector<std::string> newInstructions;
+                bool match = (reference.getMainMemory() == simulator.getMainMemory());
+                for(int r = 0; r < 32; r++)
+                {
+                    match = match && reference.getRegister(r) == simulator.getRegister(r);
+                }
 
-    //first pass to remove empty lines
-    for(std::string s : instructions)
-    {
-        if(s.length() > 0 && s[0] != '#') //not blank line or comments
-        {
-            newInstructions.push_back(s);
+                std::cout << "Verification: " << (match ? "registers and memory match the unscheduled run" : "MISMATCH with the unscheduled run") << std::endl;
+                std::cout << "Cycles: " << reference.getCycleCount() << " -> " << simulator.getCycleCount()
+                          << " (" << reference.getCycleCount() - simulator.getCycleCount() << " saved)" << std::endl;
+            }
         }
-    }
-
-    //second pass to handle and remove labels
-    for(int i = 0; i < newInstructions.size(); i++)
-    {
-        int labelEnd = newInstructions[i].find(':');
 
-        if(labelEnd != -1) //line has a label
+        if(!profilePrefix.empty())
         {
-            std::string label;
-            label = newInstructions[i].substr(0, labelEnd);
-
-            textLabels.emplace(label, i); //save index of label
-
-            newInstructions[i] = newInstructions[i].substr(labelEnd + 1); //remove label from instruction
+            profiler->writeListing(profilePrefix + ".listing");
+            profiler->writeHotList(profilePrefix + ".hot");
+            profiler->writeCollapsedStacks(profilePrefix + ".folded");
         }
     }
-
-    instructions.clear();
-    for(auto i = newInstructions.begin(); i != newInstructions.end(); i++)
+    else
     {
-        instructions.push_back(*i);
+        std::cout << error << std::endl;
     }
+
+    return 0;
 }
\ No newline at end of file
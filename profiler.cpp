@@ -0,0 +1,223 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "profiler.h"
+
+Profiler::Profiler(const std::vector<std::string>& instructions, const std::unordered_map<std::string, int>& textLabels)
+{
+    this->instructions = instructions;
+    for(std::string& s : this->instructions)
+    {
+        s.erase(0, s.find_first_not_of(" \t")); //labels leave leading whitespace behind
+    }
+    pcCounters.resize(instructions.size());
+    blockOf.resize(instructions.size());
+
+    //label names for each instruction index (sorted so the output is deterministic)
+    std::map<int, std::string> labelAt;
+    for(const auto& label : textLabels)
+    {
+        auto existing = labelAt.find(label.second);
+        if(existing == labelAt.end() || label.first < existing->second)
+        {
+            labelAt[label.second] = label.first;
+        }
+    }
+
+    //leaders: first instruction, branch targets and the instruction after a branch's delay slot
+    std::vector<bool> leader(instructions.size() + 1, false);
+    leader[0] = true;
+    for(const auto& label : labelAt)
+    {
+        if(label.first < instructions.size())
+        {
+            leader[label.first] = true;
+        }
+    }
+    for(int i = 0; i < instructions.size(); i++)
+    {
+        std::string op;
+        std::istringstream(instructions[i]) >> op;
+        if((op == "beq" || op == "j") && i + 2 <= instructions.size())
+        {
+            leader[i + 2] = true;
+        }
+    }
+
+    std::string lastLabel;
+    int lastLabelIndex = 0;
+    for(int i = 0; i < instructions.size(); i++)
+    {
+        if(labelAt.count(i))
+        {
+            lastLabel = labelAt[i];
+            lastLabelIndex = i;
+        }
+
+        if(leader[i])
+        {
+            Block block;
+            block.start = i;
+            if(labelAt.count(i))
+            {
+                block.name = labelAt[i];
+            }
+            else if(lastLabel.length() > 0)
+            {
+                block.name = lastLabel + "+" + std::to_string(i - lastLabelIndex);
+            }
+            else
+            {
+                block.name = "text+" + std::to_string(i);
+            }
+            blocks.push_back(block);
+        }
+
+        blockOf[i] = blocks.size() - 1;
+        blocks.back().end = i + 1;
+    }
+}
+
+Profiler::Counters Profiler::blockCounters(const Block& block) const
+{
+    Counters total;
+    for(int i = block.start; i < block.end; i++)
+    {
+        total.retired += pcCounters[i].retired;
+        total.stallCycles += pcCounters[i].stallCycles;
+        total.cacheMisses += pcCounters[i].cacheMisses;
+        total.mispredictions += pcCounters[i].mispredictions;
+    }
+    return total;
+}
+
+bool Profiler::writeListing(std::string fileName) const
+{
+    //Assembly listing annotated with the counters of every instruction and block
+
+    std::ofstream outFile(fileName);
+    if(!outFile.is_open())
+    {
+        std::cout << "Profile file \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+
+    outFile << std::left << std::setw(12) << "retired" << std::setw(12) << "stalls" << std::setw(10) << "misses"
+            << std::setw(10) << "mispred" << std::setw(8) << "pc" << "instruction" << std::endl;
+
+    for(const Block& block : blocks)
+    {
+        Counters total = blockCounters(block);
+        outFile << block.name << ": (" << total.retired + total.stallCycles << " cycles)" << std::endl;
+
+        for(int i = block.start; i < block.end; i++)
+        {
+            const Counters& c = pcCounters[i];
+            outFile << std::setw(12) << c.retired << std::setw(12) << c.stallCycles << std::setw(10) << c.cacheMisses
+                    << std::setw(10) << c.mispredictions << std::setw(8) << i << instructions[i] << std::endl;
+        }
+    }
+
+    return true;
+}
+
+bool Profiler::writeHotList(std::string fileName) const
+{
+    //Blocks and instructions sorted by cycles spent, hottest first. Never executed code is left out
+
+    std::ofstream outFile(fileName);
+    if(!outFile.is_open())
+    {
+        std::cout << "Profile file \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+
+    long long totalCycles = 0;
+    for(const Counters& c : pcCounters)
+    {
+        totalCycles += c.retired + c.stallCycles;
+    }
+
+    std::vector<std::pair<long long, int>> hotBlocks, hotInstructions;
+    for(int b = 0; b < blocks.size(); b++)
+    {
+        Counters total = blockCounters(blocks[b]);
+        if(total.retired > 0)
+        {
+            hotBlocks.push_back({ total.retired + total.stallCycles, b });
+        }
+    }
+    for(int i = 0; i < pcCounters.size(); i++)
+    {
+        if(pcCounters[i].retired > 0)
+        {
+            hotInstructions.push_back({ pcCounters[i].retired + pcCounters[i].stallCycles, i });
+        }
+    }
+    auto hottestFirst = [](const std::pair<long long, int>& a, const std::pair<long long, int>& b)
+    {
+        return a.first != b.first ? a.first > b.first : a.second < b.second;
+    };
+    std::sort(hotBlocks.begin(), hotBlocks.end(), hottestFirst);
+    std::sort(hotInstructions.begin(), hotInstructions.end(), hottestFirst);
+
+    outFile << std::fixed << std::setprecision(2);
+
+    outFile << "-------------------------Hot Blocks-------------------------" << std::endl;
+    outFile << std::left << std::setw(12) << "cycles" << std::setw(8) << "%" << std::setw(12) << "retired" << std::setw(12) << "stalls"
+            << std::setw(10) << "misses" << std::setw(10) << "mispred" << "block" << std::endl;
+    for(const auto& hot : hotBlocks)
+    {
+        Counters total = blockCounters(blocks[hot.second]);
+        outFile << std::setw(12) << hot.first << std::setw(8) << 100.0 * hot.first / totalCycles << std::setw(12) << total.retired
+                << std::setw(12) << total.stallCycles << std::setw(10) << total.cacheMisses << std::setw(10) << total.mispredictions
+                << blocks[hot.second].name << " [" << blocks[hot.second].start << ", " << blocks[hot.second].end << ")" << std::endl;
+    }
+
+    outFile << "-------------------------Hot Instructions-------------------------" << std::endl;
+    outFile << std::left << std::setw(12) << "cycles" << std::setw(8) << "%" << std::setw(12) << "retired" << std::setw(12) << "stalls"
+            << std::setw(10) << "misses" << std::setw(10) << "mispred" << std::setw(8) << "pc" << "instruction" << std::endl;
+    for(const auto& hot : hotInstructions)
+    {
+        const Counters& c = pcCounters[hot.second];
+        outFile << std::setw(12) << hot.first << std::setw(8) << 100.0 * hot.first / totalCycles << std::setw(12) << c.retired
+                << std::setw(12) << c.stallCycles << std::setw(10) << c.cacheMisses << std::setw(10) << c.mispredictions
+                << std::setw(8) << hot.second << instructions[hot.second] << std::endl;
+    }
+
+    return true;
+}
+
+bool Profiler::writeCollapsedStacks(std::string fileName) const
+{
+    //One "block;pc instruction cycles" line per executed instruction, the folded format read by flamegraph tools
+
+    std::ofstream outFile(fileName);
+    if(!outFile.is_open())
+    {
+        std::cout << "Profile file \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+
+    for(int i = 0; i < pcCounters.size(); i++)
+    {
+        long long cycles = pcCounters[i].retired + pcCounters[i].stallCycles;
+        if(cycles == 0)
+        {
+            continue;
+        }
+
+        std::string frame = instructions[i];
+        std::replace(frame.begin(), frame.end(), ';', ','); //';' separates frames
+
+        outFile << blocks[blockOf[i]].name << ";" << i << ": " << frame << " " << cycles << std::endl;
+    }
+
+    return true;
+}
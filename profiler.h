@@ -0,0 +1,57 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+//Per-instruction and per-basic-block profile of a simulated program.
+//Every retired instruction is counted (no sampling); cycles = retired + stall cycles
+class Profiler
+{
+    public:
+
+        Profiler(const std::vector<std::string>& instructions, const std::unordered_map<std::string, int>& textLabels);
+
+        //called once per retired instruction, kept inline so an enabled profiler stays cheap
+        void record(int pc, int stallCycles, bool cacheMiss, bool mispredicted)
+        {
+            Counters& c = pcCounters[pc];
+            c.retired++;
+            c.stallCycles += stallCycles;
+            c.cacheMisses += cacheMiss;
+            c.mispredictions += mispredicted;
+        }
+
+        bool writeListing(std::string fileName) const;
+
+        bool writeHotList(std::string fileName) const;
+
+        bool writeCollapsedStacks(std::string fileName) const;
+
+    private:
+
+        struct Counters
+        {
+            long long retired = 0;
+            long long stallCycles = 0;
+            long long cacheMisses = 0;
+            long long mispredictions = 0;
+        };
+
+        struct Block
+        {
+            int start; //first instruction index
+            int end; //one past the last instruction index
+            std::string name;
+        };
+
+        std::vector<std::string> instructions;
+        std::vector<Counters> pcCounters;
+        std::vector<Block> blocks;
+        std::vector<int> blockOf; //instruction index -> block index
+
+        Counters blockCounters(const Block& block) const;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "progcache.h"
+
+namespace
+{
+    const char CACHE_MAGIC[8] = { 'M', 'I', 'P', 'S', 'P', 'R', 'O', 'G' };
+    const uint32_t CACHE_BYTE_ORDER = 0x01020304; //entries are native-endian, reject foreign ones
+    const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+    struct CacheHeader
+    {
+        char magic[8];
+        uint32_t byteOrder;
+        uint32_t memoryWords;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint32_t instructionCount;
+        uint32_t dataLabelCount;
+        uint32_t textLabelCount;
+        uint32_t reserved;
+        uint64_t payloadSize;
+        uint64_t payloadHash; //hashBytes of everything after the header
+    };
+
+    //DecodedInstruction with a fixed layout, stored one per instruction right after the text
+    struct CachedInstruction
+    {
+        int32_t opcode;
+        int32_t rd;
+        int32_t rs;
+        int32_t rt;
+        int32_t imm;
+        int32_t immOperand;
+    };
+
+    uint64_t hashBytes(uint64_t hash, const char* data, size_t size)
+    {
+        //64-bit FNV-1a over eight bytes per step, with a shift so the high bytes also reach the low bits.
+        //Every step is invertible, so changing any single word always changes the result
+        for(; size >= 8; data += 8, size -= 8)
+        {
+            uint64_t word;
+            std::memcpy(&word, data, sizeof(word));
+            hash = (hash ^ word) * 1099511628211ULL;
+            hash ^= hash >> 32;
+        }
+        for(; size > 0; data++, size--)
+        {
+            hash = (hash ^ (unsigned char)*data) * 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    //Bounds-checked reader over the mapped payload
+    struct PayloadReader
+    {
+        const char* data;
+        size_t size;
+        size_t offset;
+        bool ok;
+
+        template <typename T>
+        T read()
+        {
+            T value = T();
+            if(offset + sizeof(T) > size)
+            {
+                ok = false;
+                return value;
+            }
+            std::memcpy(&value, data + offset, sizeof(T));
+            offset += sizeof(T);
+            return value;
+        }
+
+        std::string readString()
+        {
+            uint32_t length = read<uint32_t>();
+            if(!ok || offset + length > size)
+            {
+                ok = false;
+                return std::string();
+            }
+            std::string s(data + offset, length);
+            offset += length;
+            return s;
+        }
+    };
+
+    template <typename T>
+    void append(std::string& out, T value)
+    {
+        out.append((const char*)&value, sizeof(T));
+    }
+
+    void appendString(std::string& out, const std::string& s)
+    {
+        append<uint32_t>(out, s.length());
+        out.append(s);
+    }
+
+    bool readCacheEntry(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, Program& program)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd == -1)
+        {
+            return false;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(CacheHeader))
+        {
+            close(fd);
+            return false;
+        }
+
+        size_t fileSize = st.st_size;
+        void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapped == MAP_FAILED)
+        {
+            return false;
+        }
+
+        const char* bytes = (const char*)mapped;
+        CacheHeader header;
+        std::memcpy(&header, bytes, sizeof(header));
+
+        bool ok = std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+                  && header.byteOrder == CACHE_BYTE_ORDER
+                  && header.sourceHash == sourceHash
+                  && header.sourceSize == sourceSize
+                  && header.payloadSize == fileSize - sizeof(CacheHeader)
+                  && header.payloadHash == hashBytes(FNV_OFFSET_BASIS, bytes + sizeof(CacheHeader), header.payloadSize)
+                  && (uint64_t)header.memoryWords * 4 + (uint64_t)header.instructionCount * (4 + sizeof(CachedInstruction))
+                     + ((uint64_t)header.dataLabelCount + header.textLabelCount) * 4 <= header.payloadSize;
+
+        if(ok)
+        {
+            PayloadReader reader{ bytes + sizeof(CacheHeader), header.payloadSize, 0, true };
+
+            program.mainMemory.resize(header.memoryWords);
+            for(uint32_t i = 0; i < header.memoryWords && reader.ok; i++)
+            {
+                program.mainMemory[i] = reader.read<int32_t>();
+            }
+            program.instructions.resize(header.instructionCount);
+            for(uint32_t i = 0; i < header.instructionCount && reader.ok; i++)
+            {
+                program.instructions[i] = reader.readString();
+            }
+            program.decoded.resize(header.instructionCount);
+            for(uint32_t i = 0; i < header.instructionCount && reader.ok; i++)
+            {
+                CachedInstruction cached = reader.read<CachedInstruction>();
+                DecodedInstruction& decoded = program.decoded[i];
+                decoded.opcode = cached.opcode;
+                decoded.rd = cached.rd;
+                decoded.rs = cached.rs;
+                decoded.rt = cached.rt;
+                decoded.imm = cached.imm;
+                decoded.immOperand = cached.immOperand != 0;
+
+                //the simulator indexes with these without checking, so a damaged entry must not get through
+                bool branch = decoded.opcode == OP_BEQ || decoded.opcode == OP_J;
+                reader.ok = reader.ok && decoded.opcode >= 0 && decoded.opcode < OPCODE_COUNT
+                            && decoded.rd >= 0 && decoded.rd < 32 && decoded.rs >= 0 && decoded.rs < 32 && decoded.rt >= 0 && decoded.rt < 32
+                            && (!branch || (decoded.imm >= 0 && (uint32_t)decoded.imm < header.instructionCount));
+            }
+            for(uint32_t i = 0; i < header.dataLabelCount && reader.ok; i++)
+            {
+                std::string label = reader.readString();
+                program.dataLabels.emplace(label, reader.read<int32_t>());
+            }
+            for(uint32_t i = 0; i < header.textLabelCount && reader.ok; i++)
+            {
+                std::string label = reader.readString();
+                program.textLabels.emplace(label, reader.read<int32_t>());
+            }
+
+            ok = reader.ok && reader.offset == reader.size;
+        }
+
+        munmap(mapped, fileSize);
+
+        if(!ok)
+        {
+            program = Program();
+        }
+        return ok;
+    }
+
+    void writeCacheEntry(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, const Program& program)
+    {
+        std::string payload;
+        for(int value : program.mainMemory)
+        {
+            append<int32_t>(payload, value);
+        }
+        for(const std::string& s : program.instructions)
+        {
+            appendString(payload, s);
+        }
+        for(const DecodedInstruction& decoded : program.decoded)
+        {
+            append<CachedInstruction>(payload, { decoded.opcode, decoded.rd, decoded.rs, decoded.rt, decoded.imm, decoded.immOperand });
+        }
+        for(const auto& label : program.dataLabels)
+        {
+            appendString(payload, label.first);
+            append<int32_t>(payload, label.second);
+        }
+        for(const auto& label : program.textLabels)
+        {
+            appendString(payload, label.first);
+            append<int32_t>(payload, label.second);
+        }
+
+        CacheHeader header = { };
+        std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        header.byteOrder = CACHE_BYTE_ORDER;
+        header.memoryWords = program.mainMemory.size();
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.instructionCount = program.instructions.size();
+        header.dataLabelCount = program.dataLabels.size();
+        header.textLabelCount = program.textLabels.size();
+        header.payloadSize = payload.size();
+        header.payloadHash = hashBytes(FNV_OFFSET_BASIS, payload.data(), payload.size());
+
+        //write a private temporary file and rename it into place, so readers never see a partial entry
+        std::string tempPath = path + ".tmp" + std::to_string(getpid());
+        std::ofstream outFile(tempPath, std::ios::binary);
+        if(!outFile.is_open())
+        {
+            return; //the cache is only an optimization
+        }
+        outFile.write((const char*)&header, sizeof(header));
+        outFile.write(payload.data(), payload.size());
+        outFile.close();
+
+        if(!outFile || std::rename(tempPath.c_str(), path.c_str()) != 0)
+        {
+            std::remove(tempPath.c_str());
+        }
+    }
+}
+
+bool loadProgramCached(std::string fileName, std::string cacheDir, Program& program, std::string& error)
+{
+    std::ifstream inFile(fileName, std::ios::binary);
+    if(!inFile.is_open())
+    {
+        error = "Input file \"" + fileName + "\" could not be opened";
+        return false;
+    }
+    inFile.seekg(0, std::ios::end);
+    std::streamoff size = inFile.tellg();
+    std::string source(size > 0 ? size : 0, '\0');
+    inFile.seekg(0);
+    if(size < 0 || !inFile.read(&source[0], source.size()))
+    {
+        error = "Input file \"" + fileName + "\" could not be read";
+        return false;
+    }
+
+    uint64_t hash = hashBytes(FNV_OFFSET_BASIS, SIMULATOR_VERSION, std::strlen(SIMULATOR_VERSION) + 1);
+    hash = hashBytes(hash, source.data(), source.size());
+
+    std::ostringstream path;
+    path << cacheDir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << ".prog";
+
+    program = Program();
+    if(readCacheEntry(path.str(), hash, source.size(), program))
+    {
+        return true;
+    }
+
+    if(!loadProgram(source.data(), source.size(), program, error))
+    {
+        return false; //malformed programs are not cached
+    }
+
+    mkdir(cacheDir.c_str(), 0755); //fine if it already exists
+    writeCacheEntry(path.str(), hash, source.size(), program);
+    return true;
+}
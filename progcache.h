@@ -0,0 +1,13 @@
+#ifndef PROGCACHE_H
+#define PROGCACHE_H
+
+#include <string>
+#include "loader.h"
+
+//Persistent cache of parsed programs. Entries live in cacheDir, named after a hash of the source text and
+//SIMULATOR_VERSION, so an edited source or a new simulator version simply misses. Entries are validated
+//(header and a checksum of the payload) when mapped and rewritten if they are damaged; writes go through a temporary file and rename().
+//Fails like loadProgramFile, with the message in error
+bool loadProgramCached(std::string fileName, std::string cacheDir, Program& program, std::string& error);
+
+#endif
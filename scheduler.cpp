@@ -0,0 +1,577 @@
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include "scheduler.h"
+
+namespace
+{
+    //A register written by the instruction in slot s can be read by the instruction in slot s + RAW_DISTANCE:
+    //there is no forwarding, the write happens in WB and the read in ID (WB runs first within a cycle)
+    const int RAW_DISTANCE = 3;
+
+    //beq and j are resolved in EX, so the one instruction after them always executes
+    const int DELAY_SLOTS = 1;
+
+    struct ParsedInstruction
+    {
+        std::string text;
+        std::string op;
+        std::string dest; //empty if no register is written
+        std::vector<std::string> sources;
+        std::string target; //branch label
+        bool memRead = false;
+        bool memWrite = false;
+        bool branch = false;
+        bool known = true; //false for anything the scheduler does not understand
+    };
+
+    struct BasicBlock
+    {
+        int start;
+        int end; //one past the last instruction
+        int branch = -1; //index of beq/j in the block, -1 if none
+        bool fallsThrough = true;
+        bool schedulable = true;
+        std::vector<int> predecessors;
+    };
+
+    typedef std::map<std::string, int> Pending; //register -> slots until it can be read
+
+    ParsedInstruction parseInstruction(const std::string& text)
+    {
+        //Same syntax as the decode functions, with commas treated as whitespace
+
+        ParsedInstruction inst;
+        inst.text = text;
+
+        std::string line = text;
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::istringstream stringStream(line);
+        std::vector<std::string> operands;
+        std::string s;
+
+        stringStream >> inst.op;
+        while(stringStream >> s)
+        {
+            operands.push_back(s);
+        }
+
+        auto baseRegister = [](const std::string& offset) //"4($t0)" -> "$t0"
+        {
+            int startLoc = offset.find('(');
+            int endLoc = offset.find(')');
+            return (startLoc == -1 || endLoc == -1) ? std::string() : offset.substr(startLoc + 1, endLoc - startLoc - 1);
+        };
+
+        if(inst.op == "nop")
+        {
+            return inst;
+        }
+        else if((inst.op == "lw" || inst.op == "sw") && operands.size() == 2 && baseRegister(operands[1]).length() > 0)
+        {
+            inst.sources.push_back(baseRegister(operands[1]));
+            if(inst.op == "lw")
+            {
+                inst.dest = operands[0];
+                inst.memRead = true;
+            }
+            else
+            {
+                inst.sources.push_back(operands[0]);
+                inst.memWrite = true;
+            }
+        }
+        else if((inst.op == "add" || inst.op == "sub" || inst.op == "mult" || inst.op == "and" || inst.op == "or"
+                 || inst.op == "sll" || inst.op == "srl" || inst.op == "addi") && operands.size() == 3)
+        {
+            inst.dest = operands[0];
+            for(int i = 1; i < 3; i++)
+            {
+                if(operands[i][0] == '$')
+                {
+                    inst.sources.push_back(operands[i]);
+                }
+            }
+        }
+        else if((inst.op == "li" || inst.op == "la") && operands.size() == 2)
+        {
+            inst.dest = operands[0];
+        }
+        else if(inst.op == "beq" && operands.size() == 3)
+        {
+            inst.sources.push_back(operands[0]);
+            inst.sources.push_back(operands[1]);
+            inst.target = operands[2];
+            inst.branch = true;
+        }
+        else if(inst.op == "j" && operands.size() == 1)
+        {
+            inst.target = operands[0];
+            inst.branch = true;
+        }
+        else
+        {
+            inst.known = false;
+        }
+
+        return inst;
+    }
+
+    bool readsRegister(const ParsedInstruction& inst, const std::string& reg)
+    {
+        return reg.length() > 0 && std::find(inst.sources.begin(), inst.sources.end(), reg) != inst.sources.end();
+    }
+
+    int pendingOf(const Pending& pending, const std::string& reg)
+    {
+        auto it = pending.find(reg);
+        return it == pending.end() ? 0 : it->second;
+    }
+
+    //Walks a block in order starting from the registers still pending on entry.
+    //Returns false if an instruction reads a register before its write has completed (a data hazard)
+    bool simulateBlock(const std::vector<const ParsedInstruction*>& block, const Pending& entry, Pending& exit)
+    {
+        Pending readyAt = entry; //slot from which each register holds its new value
+        bool hazardFree = true;
+        int length = block.size();
+
+        for(int slot = 0; slot < length; slot++)
+        {
+            for(const std::string& src : block[slot]->sources)
+            {
+                if(pendingOf(readyAt, src) > slot)
+                {
+                    hazardFree = false;
+                }
+            }
+            if(block[slot]->dest.length() > 0)
+            {
+                readyAt[block[slot]->dest] = slot + RAW_DISTANCE;
+            }
+        }
+
+        exit.clear();
+        for(const auto& reg : readyAt)
+        {
+            if(reg.second > length)
+            {
+                exit[reg.first] = reg.second - length;
+            }
+        }
+
+        return hazardFree;
+    }
+
+    bool scheduleBlock(const std::vector<ParsedInstruction>& program, const BasicBlock& block, const Pending& entry,
+                       const Pending& allowedExit, bool finalBlock, std::vector<std::string>& out, ScheduleReport& report)
+    {
+        //List scheduling over the dependency DAG of the block's non-nop instructions.
+        //Returns false if no shorter hazard-free order was found
+
+        std::vector<int> nodes;
+        int branchNode = -1;
+        for(int i = block.start; i < block.end; i++)
+        {
+            if(program[i].op != "nop")
+            {
+                if(i == block.branch)
+                {
+                    branchNode = nodes.size();
+                }
+                nodes.push_back(i);
+            }
+        }
+
+        int n = nodes.size();
+        std::vector<std::vector<std::pair<int, int>>> successors(n); //(node, latency in slots)
+        std::vector<int> predecessorCount(n, 0), earliest(n, 0), height(n, 1);
+
+        for(int j = 0; j < n; j++)
+        {
+            const ParsedInstruction& b = program[nodes[j]];
+            for(const std::string& src : b.sources)
+            {
+                earliest[j] = std::max(earliest[j], pendingOf(entry, src));
+            }
+
+            for(int i = 0; i < j; i++)
+            {
+                const ParsedInstruction& a = program[nodes[i]];
+                int latency = 0;
+
+                if(readsRegister(b, a.dest)) //RAW
+                {
+                    latency = RAW_DISTANCE;
+                }
+                else if(readsRegister(a, b.dest) || (a.dest.length() > 0 && a.dest == b.dest)) //WAR, WAW
+                {
+                    latency = 1;
+                }
+                else if((a.memRead || a.memWrite) && (b.memRead || b.memWrite) && (a.memWrite || b.memWrite))
+                {
+                    latency = 1; //keep stores ordered against other memory accesses
+                }
+
+                if(latency > 0)
+                {
+                    successors[i].push_back({ j, latency });
+                    predecessorCount[j]++;
+                }
+            }
+        }
+
+        for(int i = n - 1; i >= 0; i--) //critical path length to the end of the block
+        {
+            for(const auto& edge : successors[i])
+            {
+                height[i] = std::max(height[i], edge.second + height[edge.first]);
+            }
+        }
+
+        std::vector<int> slotOf(n, -1);
+        std::vector<int> scheduled; //node per slot, -1 for nop
+        int placed = 0;
+        int originalLength = block.end - block.start;
+
+        auto place = [&](int node)
+        {
+            slotOf[node] = scheduled.size();
+            scheduled.push_back(node);
+            placed++;
+            for(const auto& edge : successors[node])
+            {
+                earliest[edge.first] = std::max(earliest[edge.first], slotOf[node] + edge.second);
+                predecessorCount[edge.first]--;
+            }
+        };
+        auto isReady = [&](int node, int slot)
+        {
+            return slotOf[node] == -1 && predecessorCount[node] == 0 && earliest[node] <= slot;
+        };
+
+        while(placed < n)
+        {
+            int slot = scheduled.size();
+            if(slot > originalLength)
+            {
+                return false; //no gain possible
+            }
+
+            if(branchNode != -1 && slotOf[branchNode] != -1)
+            {
+                //delay slot: the last remaining instruction goes here or the block cannot be shortened
+                for(int node = 0; node < n; node++)
+                {
+                    if(isReady(node, slot))
+                    {
+                        place(node);
+                        break;
+                    }
+                }
+                if(placed < n)
+                {
+                    return false;
+                }
+                break;
+            }
+
+            int remaining = n - placed - (branchNode != -1 ? 1 : 0); //non-branch instructions left
+            if(branchNode != -1 && isReady(branchNode, slot) && remaining <= DELAY_SLOTS)
+            {
+                bool delayFits = true;
+                for(int node = 0; node < n; node++)
+                {
+                    if(node != branchNode && slotOf[node] == -1)
+                    {
+                        //its only unplaced predecessor may be the branch itself
+                        bool onlyBranch = true;
+                        int ready = earliest[node];
+                        int unplaced = predecessorCount[node];
+                        for(const auto& edge : successors[branchNode])
+                        {
+                            if(edge.first == node)
+                            {
+                                unplaced--;
+                                ready = std::max(ready, slot + edge.second);
+                            }
+                        }
+                        onlyBranch = (unplaced == 0);
+                        delayFits = delayFits && onlyBranch && ready <= slot + 1;
+                    }
+                }
+                if(delayFits)
+                {
+                    place(branchNode);
+                    continue;
+                }
+            }
+
+            int best = -1;
+            for(int node = 0; node < n; node++)
+            {
+                if(node != branchNode && isReady(node, slot) && (best == -1 || height[node] > height[best]))
+                {
+                    best = node;
+                }
+            }
+
+            if(best != -1)
+            {
+                place(best);
+            }
+            else
+            {
+                scheduled.push_back(-1); //nop
+            }
+        }
+
+        if(branchNode != -1 && scheduled.size() == slotOf[branchNode] + 1)
+        {
+            scheduled.push_back(-1); //empty delay slot
+        }
+
+        //registers still pending at the end must not be worse than in the original block,
+        //because the successors were checked against the original
+        if(!finalBlock)
+        {
+            while(true)
+            {
+                std::vector<const ParsedInstruction*> order;
+                ParsedInstruction nop;
+                nop.op = "nop";
+                for(int node : scheduled)
+                {
+                    order.push_back(node == -1 ? &nop : &program[nodes[node]]);
+                }
+
+                Pending exit;
+                simulateBlock(order, entry, exit);
+
+                bool fits = true;
+                for(const auto& reg : exit)
+                {
+                    fits = fits && reg.second <= pendingOf(allowedExit, reg.first);
+                }
+                if(fits)
+                {
+                    break;
+                }
+                if(branchNode != -1)
+                {
+                    return false; //padding would have to go before the branch
+                }
+                scheduled.push_back(-1);
+            }
+        }
+        else if(scheduled.empty() && originalLength > 0)
+        {
+            scheduled.push_back(-1); //keep the text segment from ending early
+        }
+
+        if(scheduled.size() >= originalLength)
+        {
+            return false;
+        }
+
+        int nopsBefore = originalLength - n;
+        int nopsAfter = std::count(scheduled.begin(), scheduled.end(), -1);
+        report.nopsRemoved += std::max(0, nopsBefore - nopsAfter);
+        report.nopsInserted += std::max(0, nopsAfter - nopsBefore);
+
+        for(int node : scheduled)
+        {
+            out.push_back(node == -1 ? "nop" : program[nodes[node]].text);
+        }
+        return true;
+    }
+}
+
+void scheduleTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels, ScheduleReport& report)
+{
+    int size = instructions.size();
+    report.instructionsBefore = size;
+    report.instructionsAfter = size;
+
+    if(size == 0)
+    {
+        report.reason = "empty text segment";
+        return;
+    }
+
+    std::vector<ParsedInstruction> program;
+    for(const std::string& s : instructions)
+    {
+        program.push_back(parseInstruction(s));
+    }
+
+    //branch targets resolve like decode_beq/decode_j: unknown labels go to index 0
+    auto targetOf = [&](const ParsedInstruction& inst)
+    {
+        auto it = textLabels.find(inst.target);
+        return it == textLabels.end() ? 0 : it->second;
+    };
+
+    //leaders: first instruction, label targets and the instruction after a branch's delay slot
+    std::vector<bool> leader(size + 1, false);
+    leader[0] = true;
+    for(const auto& label : textLabels)
+    {
+        if(label.second < size)
+        {
+            leader[label.second] = true;
+        }
+    }
+    for(int i = 0; i < size; i++)
+    {
+        if(program[i].branch && i + 1 + DELAY_SLOTS <= size)
+        {
+            leader[i + 1 + DELAY_SLOTS] = true;
+        }
+    }
+
+    std::vector<BasicBlock> blocks;
+    std::vector<int> blockAt(size, -1); //leader index -> block
+    for(int i = 0; i < size; i++)
+    {
+        if(leader[i])
+        {
+            blockAt[i] = blocks.size();
+            blocks.push_back(BasicBlock{ i, i + 1 });
+        }
+        BasicBlock& block = blocks.back();
+        block.end = i + 1;
+
+        if(program[i].branch)
+        {
+            block.schedulable = block.schedulable && block.branch == -1;
+            block.branch = i;
+        }
+        if(!program[i].known)
+        {
+            block.schedulable = false;
+        }
+    }
+
+    for(int b = 0; b < blocks.size(); b++)
+    {
+        BasicBlock& block = blocks[b];
+
+        if(block.branch != -1)
+        {
+            //the delay slot must be inside the block, and a taken branch needs one more instruction
+            //after its delay slot or fetching stops before the branch is resolved
+            if(block.branch != block.end - 1 - DELAY_SLOTS || block.end == size)
+            {
+                block.schedulable = false;
+            }
+            block.fallsThrough = program[block.branch].op != "j";
+
+            int target = targetOf(program[block.branch]);
+            if(target < size && blockAt[target] != -1)
+            {
+                blocks[blockAt[target]].predecessors.push_back(b);
+            }
+        }
+        if(block.fallsThrough && b + 1 < blocks.size())
+        {
+            blocks[b + 1].predecessors.push_back(b);
+        }
+    }
+
+    //registers pending at each block boundary in the original program, iterated to a fixed point for loops
+    std::vector<Pending> entry(blocks.size()), exit(blocks.size());
+    bool hazardFree = true;
+    bool changed = true;
+    while(changed)
+    {
+        changed = false;
+        hazardFree = true;
+        for(int b = 0; b < blocks.size(); b++)
+        {
+            Pending in;
+            for(int p : blocks[b].predecessors)
+            {
+                for(const auto& reg : exit[p])
+                {
+                    in[reg.first] = std::max(in[reg.first], reg.second);
+                }
+            }
+
+            std::vector<const ParsedInstruction*> order;
+            for(int i = blocks[b].start; i < blocks[b].end; i++)
+            {
+                order.push_back(&program[i]);
+            }
+
+            Pending out;
+            hazardFree = simulateBlock(order, in, out) && hazardFree;
+            if(in != entry[b] || out != exit[b])
+            {
+                entry[b] = in;
+                exit[b] = out;
+                changed = true;
+            }
+        }
+    }
+
+    report.blocks = blocks.size();
+
+    if(!hazardFree)
+    {
+        //the original results depend on reading stale registers, which reordering would change
+        report.reason = "input has data hazards";
+        return;
+    }
+
+    std::vector<std::string> newInstructions;
+    std::vector<int> newStart(size, -1); //old leader index -> new index
+
+    for(int b = 0; b < blocks.size(); b++)
+    {
+        const BasicBlock& block = blocks[b];
+        newStart[block.start] = newInstructions.size();
+
+        if(!block.schedulable || !scheduleBlock(program, block, entry[b], exit[b], block.end == size, newInstructions, report))
+        {
+            for(int i = block.start; i < block.end; i++)
+            {
+                newInstructions.push_back(instructions[i]);
+            }
+        }
+        else
+        {
+            report.blocksScheduled++;
+        }
+    }
+
+    for(auto& label : textLabels)
+    {
+        if(label.second < size)
+        {
+            label.second = newStart[label.second];
+        }
+    }
+
+    instructions = newInstructions;
+    report.instructionsAfter = instructions.size();
+    report.applied = true;
+}
+
+void printScheduleReport(const ScheduleReport& report)
+{
+    std::cout << "-------------------------Scheduler-------------------------" << std::endl;
+    if(!report.applied)
+    {
+        std::cout << "Scheduling skipped: " << report.reason << std::endl;
+        return;
+    }
+    std::cout << "Instructions: " << report.instructionsBefore << " -> " << report.instructionsAfter
+              << " (" << report.instructionsBefore - report.instructionsAfter << " saved, "
+              << report.nopsRemoved << " nops removed, " << report.nopsInserted << " nops inserted)" << std::endl;
+    std::cout << "Blocks scheduled: " << report.blocksScheduled << " of " << report.blocks << std::endl;
+}
@@ -0,0 +1,27 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct ScheduleReport
+{
+    bool applied = false; //false when the program was left untouched
+    std::string reason; //why scheduling was skipped
+    int instructionsBefore = 0;
+    int instructionsAfter = 0;
+    int nopsRemoved = 0;
+    int nopsInserted = 0;
+    int blocks = 0;
+    int blocksScheduled = 0;
+};
+
+//Static list scheduler for the text segment, run after processTextSeg.
+//Reorders independent instructions of each basic block into the slots the hand-written nops were
+//covering, then inserts only the nops the pipeline still needs. Labels in textLabels are updated
+void scheduleTextSeg(std::vector<std::string>& instructions, std::unordered_map<std::string, int>& textLabels, ScheduleReport& report);
+
+void printScheduleReport(const ScheduleReport& report);
+
+#endif
@@ -5,93 +5,406 @@
 #include <sstream>
 #include <iomanip>
 #include <queue>
+#include <algorithm>
+#include <utility>
+#include <stdexcept>
+#include <unistd.h>
 #include "simulator.h"
+#include "profiler.h"
+#include "hostprofile.h"
 
-MIPS32_Simulator::MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, bool debugMode = false)
+MIPS32_Simulator::MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, bool debugMode, TimingConfig timingConfig)
+    : MIPS32_Simulator(std::move(instructions), std::move(mainMemory), std::move(dataLabels), std::move(textLabels), std::vector<DecodedInstruction>(), debugMode, timingConfig)
 {
-    this->instructions = instructions;
-    this->mainMemory = mainMemory;
-    this->dataLabels = dataLabels;
-    this->textLabels = textLabels;
+}
+
+MIPS32_Simulator::MIPS32_Simulator(const Program& program, bool debugMode, TimingConfig timingConfig)
+    : MIPS32_Simulator(program.instructions, program.mainMemory, program.dataLabels, program.textLabels, program.decoded, debugMode, timingConfig)
+{
+}
+
+MIPS32_Simulator::MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, std::vector<DecodedInstruction> decoded, bool debugMode, TimingConfig timingConfig)
+    : timing(timingConfig)
+{
+    //the arguments are already copies, take them over instead of copying a large program again
+    this->instructions = std::move(instructions);
+    this->decoded = std::move(decoded);
+    this->mainMemory = std::move(mainMemory);
+    this->dataLabels = std::move(dataLabels);
+    this->textLabels = std::move(textLabels);
     this->debugMode = debugMode;
 
     pc = -1;
     cycleCount = 0;
+    finished = false;
+    trace = nullptr;
+    profiler = nullptr;
+    retireCallback = nullptr;
+    retireContext = nullptr;
+    memoryCallback = nullptr;
+    memoryContext = nullptr;
+
+    debugHooks = false;
+    breakpoints.assign(this->instructions.size(), false);
+    memoryWatchpoints.assign(this->mainMemory.size(), 0);
+    registerWatchpoints = 0;
+    stopReason = STOP_NONE;
+    stopAddress = 0;
+
+    //programs that did not come through the loader are decoded here, an invalid one does not run
+    std::string message;
+    if(this->decoded.size() != this->instructions.size()
+       && !decodeTextSeg(this->instructions, this->dataLabels, this->textLabels, this->decoded, message))
+    {
+        fault(message);
+        finished = true;
+    }
 }
 
 void MIPS32_Simulator::executeInstructions()
 {
-    std::queue<int> pipeline;
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
+
+    while(!finished)
+    {
+        cycle();
+    }
+}
+
+void MIPS32_Simulator::cycle()
+{
+    if(pc < (int)instructions.size() - 1)
+    {
+        pipeline.push(FETCH); //put next instruction into queue
+    }
 
-    do
+    int pipelineSize = pipeline.size();
+    for(int i = 0; i < pipelineSize; i++) //for each instruction in the queue:
     {
-        if(pc < (int)instructions.size() - 1)
+        int current = pipeline.front(); //get top instruction in queue
+        pipeline.pop();
+
+        switch(current) //execute top instruction's stage
         {
-            pipeline.push(FETCH); //put next instruction into queue
+            case FETCH:
+                fetch();
+                break;
+            case DECODE:
+                decode();
+                break;
+            case EXECUTE:
+                execute();
+                break;
+            case MEMORYACCESS:
+                memoryAccess();
+                break;
+            case WRITEBACK:
+                writeBack();
+                break;
         }
 
-        int pipelineSize = pipeline.size();
-        for(int i = 0; i < pipelineSize; i++) //for each instruction in the queue:
+        if(current != WRITEBACK)
         {
-            int current = pipeline.front(); //get top instruction in queue
-            pipeline.pop();
+            //if instruction isn't finished, advance its stage and push to the back of the queue
+            current++;
+            pipeline.push(current);
+        }
+    }
 
-            switch(current) //execute top instruction's stage
-            {
-                case FETCH:
-                    fetch();
-                    break;
-                case DECODE:
-                    decode();
-                    break;
-                case EXECUTE:
-                    execute();
-                    break;
-                case MEMORYACCESS:
-                    memoryAccess();
-                    break;
-                case WRITEBACK:
-                    writeBack();
-                    break;
-            }
+    if(debugMode)
+    {
+        HOST_PROFILE_SCOPE(HOST_DEBUGPRINT);
+        std::cout << "-----CYCLE " << cycleCount << "-----" << std::endl;
+        printPipelineRegisterContents();
+        printRegisterContents();
+        printMemoryContents();
+    }
 
-            if(current != WRITEBACK)
-            {
-                //if instruction isn't finished, advance its stage and push to the back of the queue
-                current++;
-                pipeline.push(current);
-            }
-        }
+    cycleCount++;
+    finished = pipeline.empty() || !error.empty();
+    if(finished)
+    {
+        timing.finish();
+    }
+}
+
+bool MIPS32_Simulator::run()
+{
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
+
+    stopReason = STOP_NONE;
+    while(!finished && stopReason == STOP_NONE)
+    {
+        cycle();
+    }
+    return stopReason != STOP_NONE;
+}
 
-        if(debugMode)
+bool MIPS32_Simulator::step(long long cycles)
+{
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
+
+    stopReason = STOP_NONE;
+    for(long long i = 0; i < cycles && !finished && stopReason == STOP_NONE; i++)
+    {
+        cycle();
+    }
+    return !finished;
+}
+
+bool MIPS32_Simulator::runUntilPc(int pc)
+{
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
+
+    stopReason = STOP_NONE;
+    while(!finished && stopReason == STOP_NONE)
+    {
+        bool fetching = this->pc < (int)instructions.size() - 1; //same test cycle() uses to start a fetch
+        cycle();
+        if(fetching && this->pc == pc)
         {
-            std::cout << "-----CYCLE " << cycleCount << "-----" << std::endl;
-            printPipelineRegisterContents();
-            printRegisterContents();
-            printMemoryContents();
+            return true;
         }
+    }
+    return false;
+}
 
-        cycleCount++;
+bool MIPS32_Simulator::runUntilCycle(long long cycle)
+{
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
 
-    } while (!pipeline.empty());
+    stopReason = STOP_NONE;
+    while(!finished && stopReason == STOP_NONE && getCycleCount() < cycle)
+    {
+        this->cycle();
+    }
+    return getCycleCount() >= cycle;
 }
 
-template <typename T>
-void MIPS32_Simulator::printArrayContents(T& array, int arraySize)
+bool MIPS32_Simulator::runUntil(StopPredicate predicate, void* context)
 {
-    for(int i = 0; i < arraySize; i += 4)
+    HOST_PROFILE_SCOPE(HOST_SIMULATE);
+
+    stopReason = STOP_NONE;
+    while(!finished && stopReason == STOP_NONE)
     {
-        for(int t = i; t < i + 4 && t < arraySize; t++)
+        cycle();
+        if(predicate(*this, context))
         {
-            std::string stringT, stringArray;
-            stringT = std::to_string(t);
-            stringArray = std::to_string(array[t]);
-
-            std::string s("[" + stringT + "]: " + stringArray);
-            std::cout << std::left << std::setw(20) << s;
+            return true;
         }
-        std::cout << std::endl;
     }
+    return false;
+}
+
+bool MIPS32_Simulator::isFinished() const
+{
+    return finished;
+}
+
+const std::string& MIPS32_Simulator::getError() const
+{
+    return error;
+}
+
+bool MIPS32_Simulator::addBreakpoint(int pc)
+{
+    if(pc < 0 || pc >= breakpoints.size())
+    {
+        return false;
+    }
+    breakpoints[pc] = true;
+    updateDebugHooks();
+    return true;
+}
+
+bool MIPS32_Simulator::removeBreakpoint(int pc)
+{
+    if(pc < 0 || pc >= breakpoints.size())
+    {
+        return false;
+    }
+    breakpoints[pc] = false;
+    updateDebugHooks();
+    return true;
+}
+
+bool MIPS32_Simulator::addMemoryWatchpoint(int addr, int type)
+{
+    if(addr < 0 || addr >= memoryWatchpoints.size() || type < WATCH_READ || type > WATCH_ACCESS)
+    {
+        return false;
+    }
+    memoryWatchpoints[addr] |= type;
+    updateDebugHooks();
+    return true;
+}
+
+bool MIPS32_Simulator::removeMemoryWatchpoint(int addr, int type)
+{
+    if(addr < 0 || addr >= memoryWatchpoints.size() || type < WATCH_READ || type > WATCH_ACCESS)
+    {
+        return false;
+    }
+    memoryWatchpoints[addr] &= ~type;
+    updateDebugHooks();
+    return true;
+}
+
+bool MIPS32_Simulator::addRegisterWatchpoint(int index)
+{
+    if(index < 0 || index >= 32)
+    {
+        return false;
+    }
+    registerWatchpoints |= 1u << index;
+    updateDebugHooks();
+    return true;
+}
+
+bool MIPS32_Simulator::removeRegisterWatchpoint(int index)
+{
+    if(index < 0 || index >= 32)
+    {
+        return false;
+    }
+    registerWatchpoints &= ~(1u << index);
+    updateDebugHooks();
+    return true;
+}
+
+void MIPS32_Simulator::updateDebugHooks()
+{
+    debugHooks = registerWatchpoints != 0;
+    for(int i = 0; i < breakpoints.size() && !debugHooks; i++)
+    {
+        debugHooks = breakpoints[i];
+    }
+    for(int i = 0; i < memoryWatchpoints.size() && !debugHooks; i++)
+    {
+        debugHooks = memoryWatchpoints[i] != 0;
+    }
+}
+
+void MIPS32_Simulator::requestStop(STOP_REASON reason, int address)
+{
+    if(stopReason == STOP_NONE) //the first hit of a cycle is the one reported
+    {
+        stopReason = reason;
+        stopAddress = address;
+    }
+}
+
+void MIPS32_Simulator::fault(const std::string& message)
+{
+    if(error.empty())
+    {
+        error = message;
+    }
+}
+
+MIPS32_Simulator::STOP_REASON MIPS32_Simulator::getStopReason() const
+{
+    return stopReason;
+}
+
+int MIPS32_Simulator::getStopAddress() const
+{
+    return stopAddress;
+}
+
+const std::string& MIPS32_Simulator::getInstruction(int pc) const
+{
+    static const std::string none;
+    return (pc >= 0 && pc < instructions.size()) ? instructions[pc] : none;
+}
+
+int MIPS32_Simulator::getInstructionCount() const
+{
+    return instructions.size();
+}
+
+int MIPS32_Simulator::getPc() const
+{
+    return pc;
+}
+
+bool MIPS32_Simulator::setRegister(int index, int value)
+{
+    if(index < 0 || index >= 32)
+    {
+        return false;
+    }
+    registerFile[index] = value;
+    return true;
+}
+
+int MIPS32_Simulator::readMemory(int addr) const
+{
+    return (addr >= 0 && addr < mainMemory.size()) ? mainMemory[addr] : 0;
+}
+
+bool MIPS32_Simulator::writeMemory(int addr, int value)
+{
+    if(addr < 0 || addr >= mainMemory.size())
+    {
+        return false;
+    }
+    mainMemory[addr] = value;
+    return true;
+}
+
+int MIPS32_Simulator::getMemorySize() const
+{
+    return mainMemory.size();
+}
+
+void MIPS32_Simulator::setRetireCallback(RetireCallback callback, void* context)
+{
+    retireCallback = callback;
+    retireContext = context;
+}
+
+void MIPS32_Simulator::setMemoryCallback(MemoryCallback callback, void* context)
+{
+    memoryCallback = callback;
+    memoryContext = context;
+}
+
+void MIPS32_Simulator::captureTrace(std::vector<RetireRecord>* trace)
+{
+    this->trace = trace;
+}
+
+void MIPS32_Simulator::attachProfiler(Profiler* profiler)
+{
+    this->profiler = profiler;
+}
+
+long long MIPS32_Simulator::getCycleCount() const
+{
+    return cycleCount + timing.getStats().stallCycles;
+}
+
+const TimingStats& MIPS32_Simulator::getTimingStats() const
+{
+    return timing.getStats();
+}
+
+int MIPS32_Simulator::getRegister(int index) const
+{
+    return (index >= 0 && index < 32) ? registerFile[index] : 0;
+}
+
+const std::vector<int>& MIPS32_Simulator::getMainMemory() const
+{
+    return mainMemory;
+}
+
+template <typename T>
+void MIPS32_Simulator::printArrayContents(T& array, int arraySize)
+{
+    writeDump(STDOUT_FILENO, arraySize > 0 ? &array[0] : nullptr, arraySize, DumpOptions(), dumpBuffer);
 }
 
 void MIPS32_Simulator::printRegisterContents()
@@ -108,6 +421,12 @@ void MIPS32_Simulator::printMemoryContents()
     printArrayContents(mainMemory, mainMemory.size());
 }
 
+void MIPS32_Simulator::printMemoryContents(const DumpOptions& options)
+{
+    std::cout << "-------------------------Main Memory-------------------------" << std::endl;
+    writeDump(STDOUT_FILENO, mainMemory.data(), mainMemory.size(), options, dumpBuffer);
+}
+
 void MIPS32_Simulator::printPipelineRegisterContents()
 {
     int id_ex_size = sizeof(id_ex) / sizeof(int);
@@ -125,13 +444,49 @@ void MIPS32_Simulator::printPipelineRegisterContents()
     printArrayContents(mem_wb, mem_wb_size);
 }
 
+void MIPS32_Simulator::printStatistics()
+{
+    const TimingStats& stats = timing.getStats();
+
+    std::cout << "-------------------------Statistics-------------------------" << std::endl;
+    std::cout << "Cycles: " << getCycleCount() << " (" << stats.stallCycles << " stall cycles)" << std::endl;
+    std::cout << "Instructions retired: " << stats.retired << std::endl;
+    if(stats.retired > 0)
+    {
+        std::cout << "CPI: " << std::fixed << std::setprecision(3) << (double)getCycleCount() / stats.retired << std::defaultfloat << std::endl;
+    }
+    std::cout << "Data cache misses: " << stats.cacheMisses << " / " << stats.memoryAccesses << " accesses" << std::endl;
+    std::cout << "Branch mispredictions: " << stats.mispredictions << " / " << stats.branches << " branches" << std::endl;
+    if(stats.stallCycles > 0)
+    {
+        std::cout << "Stall cycles: " << stats.memoryStalls << " memory, " << stats.branchStalls << " branch, "
+                  << stats.dataStalls << " multi-cycle results, " << stats.unitStalls << " busy units" << std::endl;
+    }
+
+    long long dramRequests = stats.dramReads + stats.dramWrites;
+    if(dramRequests > 0)
+    {
+        std::cout << "DRAM requests: " << stats.dramReads << " reads, " << stats.dramWrites << " writes" << std::endl;
+        std::cout << "DRAM row hits: " << stats.rowHits << " / " << dramRequests << " (" << std::fixed << std::setprecision(1)
+                  << 100.0 * stats.rowHits / dramRequests << "%), " << stats.rowConflicts << " conflicts" << std::endl;
+        std::cout << "DRAM bandwidth: " << std::setprecision(3) << 4.0 * stats.dramWords / std::max(getCycleCount(), stats.dramLastTransfer) << " bytes/cycle" << std::defaultfloat << std::endl;
+    }
+}
+
 int MIPS32_Simulator::getRegisterIndex(std::string name) const
 {
-    return REGISTER_NAMES.at(name);
+    int index = registerIndex(name);
+    if(index == -1)
+    {
+        throw std::out_of_range("Unknown register \"" + name + "\"");
+    }
+    return index;
 }
 
 void MIPS32_Simulator::fetch()
 {
+    HOST_PROFILE_SCOPE(HOST_FETCH);
+
     //Instruction Fetch
     
     if(ex_mem[0] == 0) //PcSrc = 0
@@ -144,25 +499,42 @@ void MIPS32_Simulator::fetch()
     }
 
     if_id[0] = instructions[pc];
+    if_id_pc = pc;
+
+    if(debugHooks && breakpoints[pc])
+    {
+        requestStop(STOP_BREAKPOINT, pc);
+    }
 }
 
 void MIPS32_Simulator::decode()
 {
+    HOST_PROFILE_SCOPE(HOST_DECODE);
+
     //Instruction Decode
 
-    //parse instruction
-    std::istringstream stringStream(if_id[0]);
-    std::string str;
+    //the text was parsed once when the program was loaded
+    const DecodedInstruction& instruction = decoded[if_id_pc];
 
-    //obtain operation
-    stringStream >> str;
-    
-    //call instruction-specific decode function
-    (this->*getInstructionFunc(str))(stringStream);
+    id_ex_record = RetireRecord();
+    id_ex_record.pc = if_id_pc;
+
+    //call instruction-specific decode function, it also fills in the opcode and source registers of id_ex_record
+    (this->*INSTRUCTION_FUNCTIONS[instruction.opcode])(instruction);
+
+    if(id_ex[2] == 1) //RegWrite
+    {
+        int dest = (id_ex[8] == 0) ? id_ex[9] : id_ex[10];
+        id_ex_record.dest = (dest == 0) ? -1 : dest;
+    }
+    id_ex_record.branch = (id_ex[3] == 1); //PcSrc is only set by beq and j
+    id_ex_record.conditional = id_ex_record.branch && id_ex[12] == SUB; //beq compares with SUB, j uses ADD
 }
 
 void MIPS32_Simulator::execute()
 {
+    HOST_PROFILE_SCOPE(HOST_EXECUTE);
+
     //Execute
 
     //ALU
@@ -210,30 +582,66 @@ void MIPS32_Simulator::execute()
     ex_mem[6] = id_ex[4]; //MemToReg = MemToReg
     ex_mem[7] = id_ex[2]; //RegWrite = RegWrite
     ex_mem[8] = (id_ex[8] == 0) ? id_ex[9] : id_ex[10]; //Write Addr = WriteAddr1 or WriteAddr2 depending on RegDst
+
+    ex_mem_record = id_ex_record;
+    ex_mem_record.taken = (id_ex[3] == 1);
 }
 
 void MIPS32_Simulator::memoryAccess()
 {
+    HOST_PROFILE_SCOPE(HOST_MEMORYACCESS);
+
     //Memory Access
 
+    if((ex_mem[4] == 1 || ex_mem[5] == 1) && (ex_mem[2] < 0 || ex_mem[2] >= (int)mainMemory.size()))
+    {
+        //the access is dropped and the instruction never retires
+        fault("Memory address " + std::to_string(ex_mem[2]) + " is out of range at instruction " + std::to_string(ex_mem_record.pc)
+              + " \"" + instructions[ex_mem_record.pc] + "\"");
+        return;
+    }
+
     if(ex_mem[5] == 1) //MemWrite = 1
     {
         mainMemory[ex_mem[2]] = ex_mem[3]; //memory at Mem Addr = Write Data
+        if(memoryCallback != nullptr)
+        {
+            memoryCallback(ex_mem[2], ex_mem[3], true, memoryContext);
+        }
+        if(debugHooks && (memoryWatchpoints[ex_mem[2]] & WATCH_WRITE))
+        {
+            requestStop(STOP_WATCH_WRITE, ex_mem[2]);
+        }
     }
 
     if(ex_mem[4] == 1) //MemRead = 1
     {
         mem_wb[0] = mainMemory[ex_mem[2]]; //Memory Data = memory at Mem Addr
+        if(memoryCallback != nullptr)
+        {
+            memoryCallback(ex_mem[2], mem_wb[0], false, memoryContext);
+        }
+        if(debugHooks && (memoryWatchpoints[ex_mem[2]] & WATCH_READ))
+        {
+            requestStop(STOP_WATCH_READ, ex_mem[2]);
+        }
     }
 
     mem_wb[1] = ex_mem[2]; //ALU data = Mem Addr
     mem_wb[2] = ex_mem[8]; //Write Addr = Write Addr
     mem_wb[3] = ex_mem[6]; //MemToReg = MemToReg
     mem_wb[4] = ex_mem[7]; //RegWrite = RegWrite
+
+    mem_wb_record = ex_mem_record;
+    mem_wb_record.memRead = (ex_mem[4] == 1);
+    mem_wb_record.memWrite = (ex_mem[5] == 1);
+    mem_wb_record.memAddr = ex_mem[2];
 }
 
 void MIPS32_Simulator::writeBack()
 {
+    HOST_PROFILE_SCOPE(HOST_WRITEBACK);
+
     //Write Back
 
     if(mem_wb[4] == 1) //RegWrite == 1
@@ -246,5 +654,25 @@ void MIPS32_Simulator::writeBack()
         {
             registerFile[mem_wb[2]] = mem_wb[1]; //register at Write Addr = ALU data
         }
+
+        if(debugHooks && ((registerWatchpoints >> mem_wb[2]) & 1))
+        {
+            requestStop(STOP_WATCH_REGISTER, mem_wb[2]);
+        }
+    }
+
+    //instruction is finished, let the timing model account for it
+    int stall = timing.retire(mem_wb_record);
+    if(profiler != nullptr)
+    {
+        profiler->record(mem_wb_record.pc, stall, timing.lastAccessMissed(), timing.lastBranchMispredicted());
+    }
+    if(trace != nullptr)
+    {
+        trace->push_back(mem_wb_record);
+    }
+    if(retireCallback != nullptr)
+    {
+        retireCallback(mem_wb_record, retireContext);
     }
 }
\ No newline at end of file
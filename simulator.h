@@ -1,14 +1,112 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <string>
 #include <vector>
+#include <queue>
 #include <unordered_map>
+#include "timing.h"
+#include "loader.h"
+#include "dump.h"
+
+class Profiler;
 
 class MIPS32_Simulator
 {
     public:
 
-        MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, bool debugMode);
+        MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, bool debugMode, TimingConfig timingConfig = TimingConfig());
+
+        MIPS32_Simulator(const Program& program, bool debugMode = false, TimingConfig timingConfig = TimingConfig());
+
+        /* Callbacks for embedding, called with the context pointer they were registered with */
+        typedef void (*RetireCallback)(const RetireRecord& record, void* context);
+        typedef void (*MemoryCallback)(int addr, int value, bool write, void* context);
+        typedef bool (*StopPredicate)(const MIPS32_Simulator& simulator, void* context);
+
+        enum STOP_REASON
+        {
+            STOP_NONE,
+            STOP_BREAKPOINT,
+            STOP_WATCH_READ,
+            STOP_WATCH_WRITE,
+            STOP_WATCH_REGISTER
+        };
+
+        enum WATCH_TYPE
+        {
+            WATCH_READ = 1,
+            WATCH_WRITE = 2,
+            WATCH_ACCESS = 3
+        };
 
         void executeInstructions();
 
+        bool run(); //runs until a breakpoint or watchpoint hits (true) or the program finishes (false)
+
+        bool step(long long cycles = 1); //returns false once the program has finished
+
+        bool runUntilPc(int pc); //stops after the cycle that fetches instruction index pc, false if the program finished first
+
+        bool runUntilCycle(long long cycle);
+
+        bool runUntil(StopPredicate predicate, void* context); //predicate is checked after every cycle
+
+        bool isFinished() const;
+
+        const std::string& getError() const; //why the run ended early (invalid program or memory access out of range), empty otherwise
+
+        /* Breakpoints and watchpoints stop run(), step() and runUntil*() after the cycle in which they hit.
+           Each call returns false and changes nothing for an index out of range or an unknown type */
+        bool addBreakpoint(int pc); //hits when instruction index pc is fetched
+
+        bool removeBreakpoint(int pc);
+
+        bool addMemoryWatchpoint(int addr, int type); //type is a WATCH_TYPE
+
+        bool removeMemoryWatchpoint(int addr, int type);
+
+        bool addRegisterWatchpoint(int index); //hits when the register is written in WB
+
+        bool removeRegisterWatchpoint(int index);
+
+        STOP_REASON getStopReason() const; //why the last run call stopped early, STOP_NONE if it did not
+
+        int getStopAddress() const; //instruction index, memory address or register index of the hit
+
+        int getRegisterIndex(std::string name) const; //throws std::out_of_range for an unknown name
+
+        const std::string& getInstruction(int pc) const; //empty string for an index outside the text segment
+
+        int getInstructionCount() const;
+
+        int getPc() const;
+
+        /* Out-of-range indices are rejected: setters return false and change nothing, readMemory and getRegister return 0 */
+        bool setRegister(int index, int value);
+
+        int readMemory(int addr) const;
+
+        bool writeMemory(int addr, int value);
+
+        int getMemorySize() const;
+
+        void setRetireCallback(RetireCallback callback, void* context);
+
+        void setMemoryCallback(MemoryCallback callback, void* context);
+
+        void captureTrace(std::vector<RetireRecord>* trace);
+
+        void attachProfiler(Profiler* profiler);
+
+        long long getCycleCount() const;
+
+        const TimingStats& getTimingStats() const;
+
+        int getRegister(int index) const;
+
+        const std::vector<int>& getMainMemory() const;
+
         template <typename T>
         void printArrayContents(T& array, int arraySize);
 
@@ -16,38 +114,54 @@ class MIPS32_Simulator
 
         void printMemoryContents();
 
+        void printMemoryContents(const DumpOptions& options); //only the cells selected by options
+
         void printPipelineRegisterContents();
 
+        void printStatistics();
+
     private:
 
-        typedef void (MIPS32_Simulator::*decodeFunction)(std::istringstream&);
+        typedef void (MIPS32_Simulator::*decodeFunction)(const DecodedInstruction&);
+
+        //Both public constructors end up here, decoded is decoded again unless it has one entry per instruction
+        MIPS32_Simulator(std::vector<std::string> instructions, std::vector<int> mainMemory, std::unordered_map<std::string, int> dataLabels, std::unordered_map<std::string, int> textLabels, std::vector<DecodedInstruction> decoded, bool debugMode, TimingConfig timingConfig);
 
         std::vector<std::string> instructions;
+        std::vector<DecodedInstruction> decoded; //read by the ID stage instead of parsing the text every cycle
         std::vector<int> mainMemory;
         std::unordered_map<std::string, int> dataLabels;
         std::unordered_map<std::string, int> textLabels;
         bool debugMode;
         int pc; //Program counter
         int cycleCount;
-
-        const std::unordered_map<std::string, int> REGISTER_NAMES
+        bool finished; //pipeline drained after the last instruction
+        std::queue<int> pipeline; //stage of every instruction in flight, oldest first
+        TimingModel timing;
+        std::vector<RetireRecord>* trace; //retired instruction stream, recorded when not null
+        Profiler* profiler; //per-instruction profile, recorded when not null
+        RetireCallback retireCallback;
+        void* retireContext;
+        MemoryCallback memoryCallback;
+        void* memoryContext;
+        std::vector<char> dumpBuffer; //reused by every print so debug mode does not allocate per cycle
+
+        //Debug hooks, only looked at when debugHooks is set so a run without any costs a single flag test
+        bool debugHooks;
+        std::vector<bool> breakpoints; //per instruction index
+        std::vector<unsigned char> memoryWatchpoints; //WATCH_TYPE bits per memory word
+        unsigned int registerWatchpoints; //one bit per register
+        STOP_REASON stopReason;
+        int stopAddress;
+        std::string error; //set by fault(), the run ends after the cycle that set it
+
+        //indexed by OPCODE
+        const decodeFunction INSTRUCTION_FUNCTIONS[OPCODE_COUNT]
         {
-            { "$zero", 0 }, { "$at", 1 }, { "$v0", 2 }, { "$v1", 3 },
-            { "$a0", 4 }, { "$a1", 5 }, { "$a2", 6 }, { "$a3", 7 },
-            { "$t0", 8 }, { "$t1", 9 }, { "$t2", 10 }, { "$t3", 11 },
-            { "$t4", 12 }, { "$t5", 13 }, { "$t6", 14 }, { "$t7", 15 },
-            { "$s0", 16 }, { "$s1", 17 }, { "$s2", 18 }, { "$s3", 19 },
-            { "$s4", 20 }, { "$s5", 21 }, { "$s6", 22 }, { "$s7", 23 },
-            { "$t8", 24 }, { "$t9", 25 }, { "$k0", 26 }, { "$k1", 27 },
-            { "$gp", 28 }, { "$sp", 29 }, { "$fp", 30 }, { "$ra", 31 }
-        };
-
-        const std::unordered_map<std::string, decodeFunction> INSTRUCTION_NAMES
-        {
-            { "sw", &MIPS32_Simulator::decode_sw }, { "lw", &MIPS32_Simulator::decode_lw }, { "add", &MIPS32_Simulator::decode_add }, { "addi", &MIPS32_Simulator::decode_addi },
-            { "sub", &MIPS32_Simulator::decode_sub }, { "mult", &MIPS32_Simulator::decode_mult }, { "and", &MIPS32_Simulator::decode_and }, { "or", &MIPS32_Simulator::decode_or },
-            { "li", &MIPS32_Simulator::decode_li }, { "la", &MIPS32_Simulator::decode_la }, { "sll", &MIPS32_Simulator::decode_sll }, { "srl", &MIPS32_Simulator::decode_srl },
-            { "beq", &MIPS32_Simulator::decode_beq }, { "j", &MIPS32_Simulator::decode_j }, { "nop", &MIPS32_Simulator::decode_nop }
+            &MIPS32_Simulator::decode_add, &MIPS32_Simulator::decode_addi, &MIPS32_Simulator::decode_sub, &MIPS32_Simulator::decode_mult,
+            &MIPS32_Simulator::decode_and, &MIPS32_Simulator::decode_or, &MIPS32_Simulator::decode_sll, &MIPS32_Simulator::decode_srl,
+            &MIPS32_Simulator::decode_li, &MIPS32_Simulator::decode_la, &MIPS32_Simulator::decode_lw, &MIPS32_Simulator::decode_sw,
+            &MIPS32_Simulator::decode_beq, &MIPS32_Simulator::decode_j, &MIPS32_Simulator::decode_nop
         };
 
         int registerFile[32] = { };
@@ -94,6 +208,12 @@ class MIPS32_Simulator
            mem_wb[4] = RegWrite
         */
 
+        //Bookkeeping carried alongside the pipeline registers for the timing models (not part of the datapath)
+        int if_id_pc = 0;
+        RetireRecord id_ex_record;
+        RetireRecord ex_mem_record;
+        RetireRecord mem_wb_record;
+
         enum ALU_OP
         {
             ADD,
@@ -114,10 +234,6 @@ class MIPS32_Simulator
             WRITEBACK
         };
 
-        int getRegisterIndex(std::string name) const;
-
-        decodeFunction getInstructionFunc(std::string identifier) const;
-
         void applyStoreOpCodes();
 
         void applyLoadOpCodes();
@@ -126,7 +242,15 @@ class MIPS32_Simulator
 
         void applyBranchOpCodes();
 
-        void applyRTypeCodes(std::istringstream& stringStream);
+        void applyRTypeCodes(const DecodedInstruction& instruction);
+
+        void cycle();
+
+        void updateDebugHooks();
+
+        void requestStop(STOP_REASON reason, int address);
+
+        void fault(const std::string& message);
 
         void fetch();
 
@@ -139,33 +263,35 @@ class MIPS32_Simulator
         void writeBack();
 
         /* Instruction-specific decode functions */
-        void decode_sw(std::istringstream& stringStream);
+        void decode_sw(const DecodedInstruction& instruction);
 
-        void decode_lw(std::istringstream& stringStream);
+        void decode_lw(const DecodedInstruction& instruction);
 
-        void decode_add(std::istringstream& stringStream);
+        void decode_add(const DecodedInstruction& instruction);
 
-        void decode_addi(std::istringstream& stringStream);
+        void decode_addi(const DecodedInstruction& instruction);
 
-        void decode_sub(std::istringstream& stringStream);
+        void decode_sub(const DecodedInstruction& instruction);
 
-        void decode_mult(std::istringstream& stringStream);
+        void decode_mult(const DecodedInstruction& instruction);
 
-        void decode_and(std::istringstream& stringStream);
+        void decode_and(const DecodedInstruction& instruction);
 
-        void decode_or(std::istringstream& stringStream);
+        void decode_or(const DecodedInstruction& instruction);
 
-        void decode_sll(std::istringstream& stringStream);
+        void decode_sll(const DecodedInstruction& instruction);
 
-        void decode_srl(std::istringstream& stringStream);
+        void decode_srl(const DecodedInstruction& instruction);
 
-        void decode_li(std::istringstream& stringStream);
+        void decode_li(const DecodedInstruction& instruction);
 
-        void decode_la(std::istringstream& stringStream);
+        void decode_la(const DecodedInstruction& instruction);
 
-        void decode_beq(std::istringstream& stringStream);
+        void decode_beq(const DecodedInstruction& instruction);
 
-        void decode_j(std::istringstream& stringStream);
+        void decode_j(const DecodedInstruction& instruction);
 
-        void decode_nop(std::istringstream& stringStream);
+        void decode_nop(const DecodedInstruction& instruction);
 };
+
+#endif
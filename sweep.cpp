@@ -0,0 +1,198 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <ctime>
+#include <algorithm>
+#include "sweep.h"
+
+struct SweepResult
+{
+    TimingStats stats;
+    double cpuMilliseconds;
+};
+
+static double threadCpuMilliseconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+bool readSweepGrid(std::string fileName, SweepGrid& grid)
+{
+    //Grid file format, one parameter per line: "cache.size = 0, 64, 256"
+    //Blank lines and lines starting with '#' are ignored
+
+    std::ifstream inFile(fileName);
+
+    if(!inFile.is_open())
+    {
+        std::cout << "Sweep file \"" << fileName << "\" could not be opened" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(inFile, line))
+    {
+        if(line.length() == 0 || line[0] == '#')
+        {
+            continue;
+        }
+
+        int equals = line.find('=');
+        if(equals == -1)
+        {
+            std::cout << "Sweep line \"" << line << "\" has no '='" << std::endl;
+            return false;
+        }
+
+        std::string key;
+        std::istringstream(line.substr(0, equals)) >> key;
+
+        std::vector<std::string> values;
+        std::istringstream valueStream(line.substr(equals + 1));
+        std::string value;
+        while(std::getline(valueStream, value, ','))
+        {
+            std::string trimmed;
+            std::istringstream(value) >> trimmed;
+            if(trimmed.length() > 0)
+            {
+                values.push_back(trimmed);
+            }
+        }
+
+        if(key.length() == 0 || values.empty())
+        {
+            std::cout << "Sweep line \"" << line << "\" needs a parameter and at least one value" << std::endl;
+            return false;
+        }
+
+        grid.push_back({ key, values });
+    }
+
+    return true;
+}
+
+bool expandSweepGrid(const SweepGrid& grid, const TimingConfig& base, std::vector<TimingConfig>& configs)
+{
+    //Cartesian product of all parameter values, last parameter varying fastest
+
+    std::vector<int> choice(grid.size(), 0);
+    std::string error;
+
+    while(true)
+    {
+        TimingConfig config = base;
+        for(int i = 0; i < grid.size(); i++)
+        {
+            if(!config.set(grid[i].first, grid[i].second[choice[i]], error))
+            {
+                std::cout << error << std::endl;
+                return false;
+            }
+        }
+        if(!config.isValid(error))
+        {
+            std::cout << error << std::endl;
+            return false;
+        }
+        configs.push_back(config);
+
+        int i = (int)grid.size() - 1;
+        while(i >= 0 && ++choice[i] == grid[i].second.size())
+        {
+            choice[i] = 0;
+            i--;
+        }
+        if(i < 0)
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+void runSweep(const SweepGrid& grid, const std::vector<TimingConfig>& configs, const std::vector<RetireRecord>& trace, long long pipelineCycles, int threadCount)
+{
+    //Every configuration replays the same captured instruction stream through its own timing model.
+    //Stalls freeze the whole pipeline, so cycles = pipeline cycles of the functional run + stall cycles
+
+    std::vector<SweepResult> results(configs.size());
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]()
+    {
+        size_t index;
+        while((index = next++) < configs.size())
+        {
+            double start = threadCpuMilliseconds();
+
+            TimingModel model(configs[index]);
+            for(const RetireRecord& record : trace)
+            {
+                model.retire(record);
+            }
+            model.finish();
+
+            results[index].stats = model.getStats();
+            results[index].cpuMilliseconds = threadCpuMilliseconds() - start;
+        }
+    };
+
+    if(threadCount < 1)
+    {
+        threadCount = 1;
+    }
+    if(threadCount > configs.size())
+    {
+        threadCount = configs.size();
+    }
+
+    std::vector<std::thread> threads;
+    for(int i = 0; i < threadCount; i++)
+    {
+        threads.emplace_back(worker);
+    }
+    for(std::thread& t : threads)
+    {
+        t.join();
+    }
+
+    std::cout << "-------------------------Sweep (" << configs.size() << " configurations, " << threadCount << " threads)-------------------------" << std::endl;
+
+    std::cout << std::left << std::setw(6) << "#";
+    for(const auto& parameter : grid)
+    {
+        std::cout << std::setw(std::max<int>(parameter.first.length() + 2, 10)) << parameter.first;
+    }
+    std::cout << std::setw(12) << "cycles" << std::setw(12) << "stalls" << std::setw(8) << "CPI"
+              << std::setw(10) << "miss%" << std::setw(10) << "rowhit%" << std::setw(10) << "mispred" << std::setw(10) << "cpu ms" << std::endl;
+
+    for(int i = 0; i < configs.size(); i++)
+    {
+        const TimingStats& stats = results[i].stats;
+        long long cycles = pipelineCycles + stats.stallCycles;
+        double cpi = stats.retired > 0 ? (double)cycles / stats.retired : 0.0;
+        double missRate = stats.memoryAccesses > 0 ? 100.0 * stats.cacheMisses / stats.memoryAccesses : 0.0;
+        long long dramRequests = stats.dramReads + stats.dramWrites;
+        double rowHitRate = dramRequests > 0 ? 100.0 * stats.rowHits / dramRequests : 0.0;
+
+        std::cout << std::setw(6) << i;
+        for(const auto& parameter : grid)
+        {
+            std::cout << std::setw(std::max<int>(parameter.first.length() + 2, 10)) << configs[i].get(parameter.first);
+        }
+        std::cout << std::setw(12) << cycles << std::setw(12) << stats.stallCycles
+                  << std::fixed << std::setprecision(3) << std::setw(8) << cpi
+                  << std::setprecision(2) << std::setw(10) << missRate << std::setw(10) << rowHitRate
+                  << std::setw(10) << stats.mispredictions
+                  << std::setprecision(3) << std::setw(10) << results[i].cpuMilliseconds << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include "timing.h"
+
+//Parameter name and the values to try for it
+typedef std::vector<std::pair<std::string, std::vector<std::string>>> SweepGrid;
+
+bool readSweepGrid(std::string fileName, SweepGrid& grid);
+
+bool expandSweepGrid(const SweepGrid& grid, const TimingConfig& base, std::vector<TimingConfig>& configs);
+
+void runSweep(const SweepGrid& grid, const std::vector<TimingConfig>& configs, const std::vector<RetireRecord>& trace, long long pipelineCycles, int threadCount);
+
+#endif
@@ -0,0 +1,631 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include "timing.h"
+
+bool TimingConfig::set(const std::string& key, const std::string& value, std::string& error)
+{
+    if(key == "predictor")
+    {
+        if(value != "perfect" && value != "not-taken" && value != "taken" && value != "bimodal")
+        {
+            error = "Unknown predictor \"" + value + "\"";
+            return false;
+        }
+        predictor = value;
+        return true;
+    }
+    if(key == "memory.model")
+    {
+        if(value != "fixed" && value != "dram")
+        {
+            error = "Unknown memory model \"" + value + "\"";
+            return false;
+        }
+        memoryModel = value;
+        return true;
+    }
+    if(key == "branch.stage")
+    {
+        if(value != "id" && value != "ex")
+        {
+            error = "Unknown branch stage \"" + value + "\"";
+            return false;
+        }
+        branchStage = value;
+        return true;
+    }
+    if(key == "dram.policy")
+    {
+        if(value != "open" && value != "closed")
+        {
+            error = "Unknown row policy \"" + value + "\"";
+            return false;
+        }
+        dramPolicy = value;
+        return true;
+    }
+
+    int n;
+    try
+    {
+        n = std::stoi(value);
+    }
+    catch(const std::exception&)
+    {
+        error = "Invalid value \"" + value + "\" for " + key;
+        return false;
+    }
+
+    if(key == "cache.size")
+    {
+        cacheSize = n;
+    }
+    else if(key == "cache.line")
+    {
+        cacheLineSize = n;
+    }
+    else if(key == "cache.assoc")
+    {
+        cacheAssociativity = n;
+    }
+    else if(key == "cache.hit")
+    {
+        cacheHitLatency = n;
+    }
+    else if(key == "memory.latency")
+    {
+        memoryLatency = n;
+    }
+    else if(key.compare(0, 8, "latency.") == 0 || key.compare(0, 10, "pipelined.") == 0)
+    {
+        std::string name = key.substr(key.find('.') + 1);
+        int op = 0;
+        while(op < OPCODE_COUNT && name != OPCODE_NAMES[op])
+        {
+            op++;
+        }
+        if(op == OPCODE_COUNT)
+        {
+            error = "Unknown opcode \"" + name + "\"";
+            return false;
+        }
+        (key[0] == 'l' ? opLatency : opPipelined)[op] = n;
+    }
+    else if(key == "dram.channels")
+    {
+        dramChannels = n;
+    }
+    else if(key == "dram.banks")
+    {
+        dramBanks = n;
+    }
+    else if(key == "dram.row")
+    {
+        dramRowSize = n;
+    }
+    else if(key == "dram.tRCD")
+    {
+        dramRCD = n;
+    }
+    else if(key == "dram.tCAS")
+    {
+        dramCAS = n;
+    }
+    else if(key == "dram.tRP")
+    {
+        dramRP = n;
+    }
+    else if(key == "dram.width")
+    {
+        dramWidth = n;
+    }
+    else if(key == "dram.queue")
+    {
+        dramQueue = n;
+    }
+    else if(key == "predictor.entries")
+    {
+        predictorEntries = n;
+    }
+    else if(key == "predictor.penalty")
+    {
+        mispredictPenalty = n;
+    }
+    else
+    {
+        error = "Unknown parameter \"" + key + "\"";
+        return false;
+    }
+
+    return true;
+}
+
+std::string TimingConfig::get(const std::string& key) const
+{
+    if(key == "predictor") return predictor;
+    if(key == "cache.size") return std::to_string(cacheSize);
+    if(key == "cache.line") return std::to_string(cacheLineSize);
+    if(key == "cache.assoc") return std::to_string(cacheAssociativity);
+    if(key == "cache.hit") return std::to_string(cacheHitLatency);
+    if(key == "memory.latency") return std::to_string(memoryLatency);
+    if(key == "branch.stage") return branchStage;
+    for(int op = 0; op < OPCODE_COUNT; op++)
+    {
+        if(key == std::string("latency.") + OPCODE_NAMES[op]) return std::to_string(opLatency[op]);
+        if(key == std::string("pipelined.") + OPCODE_NAMES[op]) return std::to_string(opPipelined[op]);
+    }
+    if(key == "memory.model") return memoryModel;
+    if(key == "dram.channels") return std::to_string(dramChannels);
+    if(key == "dram.banks") return std::to_string(dramBanks);
+    if(key == "dram.row") return std::to_string(dramRowSize);
+    if(key == "dram.policy") return dramPolicy;
+    if(key == "dram.tRCD") return std::to_string(dramRCD);
+    if(key == "dram.tCAS") return std::to_string(dramCAS);
+    if(key == "dram.tRP") return std::to_string(dramRP);
+    if(key == "dram.width") return std::to_string(dramWidth);
+    if(key == "dram.queue") return std::to_string(dramQueue);
+    if(key == "predictor.entries") return std::to_string(predictorEntries);
+    if(key == "predictor.penalty") return std::to_string(mispredictPenalty);
+    return "";
+}
+
+bool TimingConfig::isValid(std::string& error) const
+{
+    if(cacheSize < 0 || cacheLineSize <= 0 || cacheAssociativity <= 0 || predictorEntries <= 0)
+    {
+        error = "Cache and predictor sizes must be positive";
+        return false;
+    }
+    if(cacheHitLatency < 0 || memoryLatency < 0 || mispredictPenalty < 0)
+    {
+        error = "Latencies must not be negative";
+        return false;
+    }
+    if(cacheSize % (cacheLineSize * cacheAssociativity) != 0)
+    {
+        error = "cache.size must be a multiple of cache.line * cache.assoc";
+        return false;
+    }
+    for(int op = 0; op < OPCODE_COUNT; op++)
+    {
+        if(opLatency[op] < 1 || (opPipelined[op] != 0 && opPipelined[op] != 1))
+        {
+            error = std::string("latency.") + OPCODE_NAMES[op] + " must be at least 1 and pipelined." + OPCODE_NAMES[op] + " 0 or 1";
+            return false;
+        }
+    }
+    if(dramChannels <= 0 || dramBanks <= 0 || dramRowSize <= 0 || dramWidth <= 0 || dramQueue <= 0)
+    {
+        error = "DRAM sizes must be positive";
+        return false;
+    }
+    if(dramRCD < 0 || dramCAS < 0 || dramRP < 0)
+    {
+        error = "Latencies must not be negative";
+        return false;
+    }
+    if(cacheSize > 0 && dramRowSize % cacheLineSize != 0)
+    {
+        error = "dram.row must be a multiple of cache.line";
+        return false;
+    }
+    return true;
+}
+
+Cache::Cache(int size, int lineSize, int associativity)
+{
+    this->lineSize = lineSize;
+    this->associativity = associativity;
+
+    numSets = size / (lineSize * associativity);
+    useCounter = 0;
+    lines.assign(numSets * associativity, Line{ false, false, 0, 0 });
+}
+
+bool Cache::access(int addr, bool write, bool& writeBack, int& writeBackAddr)
+{
+    int block = addr / lineSize;
+    int set = block % numSets;
+    int tag = block / numSets;
+    Line* ways = &lines[set * associativity];
+
+    writeBack = false;
+    useCounter++;
+
+    Line* victim = &ways[0];
+    for(int i = 0; i < associativity; i++)
+    {
+        if(ways[i].valid && ways[i].tag == tag) //hit
+        {
+            ways[i].lastUse = useCounter;
+            ways[i].dirty = ways[i].dirty || write;
+            return true;
+        }
+
+        //prefer an empty way, otherwise the least recently used one
+        if(!ways[i].valid)
+        {
+            if(victim->valid)
+            {
+                victim = &ways[i];
+            }
+        }
+        else if(victim->valid && ways[i].lastUse < victim->lastUse)
+        {
+            victim = &ways[i];
+        }
+    }
+
+    writeBack = victim->valid && victim->dirty;
+    writeBackAddr = (victim->tag * numSets + set) * lineSize;
+    victim->valid = true;
+    victim->dirty = write;
+    victim->tag = tag;
+    victim->lastUse = useCounter;
+    return false;
+}
+
+DramModel::DramModel(const TimingConfig& config) : config(config)
+{
+    banks.assign(config.dramChannels * config.dramBanks, Bank{ -1, 0 });
+    busFreeAt.assign(config.dramChannels, 0);
+}
+
+DramModel::Request DramModel::makeRequest(int addr, int words, bool write, long long now) const
+{
+    int rowIndex = addr / config.dramRowSize;
+
+    Request request;
+    request.channel = rowIndex % config.dramChannels;
+    request.bank = (rowIndex / config.dramChannels) % config.dramBanks;
+    request.row = rowIndex / (config.dramChannels * config.dramBanks);
+    request.words = words;
+    request.write = write;
+    request.arrival = now;
+    return request;
+}
+
+int DramModel::pick(int channel) const
+{
+    int oldest = -1;
+    for(int i = 0; i < queue.size(); i++)
+    {
+        const Request& request = queue[i];
+        if(request.channel != channel)
+        {
+            continue;
+        }
+        if(banks[channel * config.dramBanks + request.bank].openRow == request.row)
+        {
+            return i; //the queue is in arrival order, so this is the oldest row hit
+        }
+        if(oldest == -1)
+        {
+            oldest = i;
+        }
+    }
+    return oldest;
+}
+
+long long DramModel::service(const Request& request, long long& start, TimingStats& stats)
+{
+    Bank& bank = banks[request.channel * config.dramBanks + request.bank];
+    start = std::max(request.arrival, bank.readyAt);
+
+    int latency = config.dramCAS;
+    if(bank.openRow == request.row)
+    {
+        stats.rowHits++;
+    }
+    else if(bank.openRow == -1)
+    {
+        latency += config.dramRCD;
+    }
+    else
+    {
+        latency += config.dramRP + config.dramRCD;
+        stats.rowConflicts++;
+    }
+
+    int transfer = (request.words + config.dramWidth - 1) / config.dramWidth;
+    long long dataStart = std::max(start + latency, busFreeAt[request.channel]);
+    long long done = dataStart + transfer;
+    busFreeAt[request.channel] = done;
+
+    if(config.dramPolicy == "closed")
+    {
+        bank.openRow = -1;
+        bank.readyAt = done + config.dramRP;
+    }
+    else
+    {
+        //the next column command to the open row can overlap this one's data transfer
+        bank.openRow = request.row;
+        bank.readyAt = std::max(start, done - config.dramCAS);
+    }
+
+    if(request.write)
+    {
+        stats.dramWrites++;
+    }
+    else
+    {
+        stats.dramReads++;
+    }
+    stats.dramWords += request.words;
+    stats.dramLastTransfer = std::max(stats.dramLastTransfer, done);
+    return done;
+}
+
+void DramModel::drain(long long now, TimingStats& stats)
+{
+    for(int channel = 0; channel < config.dramChannels; channel++)
+    {
+        int i;
+        while((i = pick(channel)) != -1)
+        {
+            const Request& request = queue[i];
+            if(std::max(request.arrival, banks[channel * config.dramBanks + request.bank].readyAt) >= now)
+            {
+                break;
+            }
+
+            long long start;
+            service(request, start, stats);
+            queue.erase(queue.begin() + i);
+        }
+    }
+}
+
+void DramModel::flush(TimingStats& stats)
+{
+    drain(std::numeric_limits<long long>::max(), stats);
+}
+
+long long DramModel::read(int addr, int words, long long now, TimingStats& stats)
+{
+    drain(now, stats);
+
+    Request read = makeRequest(addr, words, false, now);
+    queue.push_back(read);
+
+    //queued writes to an open row, or older than a read that misses, go first
+    while(true)
+    {
+        int i = pick(read.channel);
+        Request request = queue[i];
+        queue.erase(queue.begin() + i);
+
+        long long start;
+        long long done = service(request, start, stats);
+        if(!request.write)
+        {
+            return done;
+        }
+    }
+}
+
+long long DramModel::write(int addr, int words, long long now, TimingStats& stats)
+{
+    drain(now, stats);
+
+    long long accepted = now;
+    while(queue.size() >= config.dramQueue) //full, wait until the scheduler issues one
+    {
+        int i = pick(queue.front().channel);
+        Request request = queue[i];
+        queue.erase(queue.begin() + i);
+
+        long long start;
+        service(request, start, stats);
+        accepted = std::max(accepted, start);
+    }
+
+    queue.push_back(makeRequest(addr, words, true, now));
+    return accepted;
+}
+
+BranchPredictor::BranchPredictor(const std::string& type, int entries)
+{
+    this->type = type;
+
+    if(type == "bimodal")
+    {
+        counters.assign(entries, 1); //weakly not taken
+    }
+}
+
+bool BranchPredictor::predict(int pc) const
+{
+    if(type == "taken")
+    {
+        return true;
+    }
+    if(type == "bimodal")
+    {
+        return counters[pc % counters.size()] >= 2;
+    }
+    return false; //not-taken
+}
+
+void BranchPredictor::update(int pc, bool taken)
+{
+    if(type != "bimodal")
+    {
+        return;
+    }
+
+    unsigned char& counter = counters[pc % counters.size()];
+    if(taken && counter < 3)
+    {
+        counter++;
+    }
+    else if(!taken && counter > 0)
+    {
+        counter--;
+    }
+}
+
+TimingModel::TimingModel(const TimingConfig& config)
+    : config(config),
+      hasCache(config.cacheSize > 0),
+      perfectPredictor(config.predictor == "perfect"),
+      hasDram(config.memoryModel == "dram"),
+      cache(config.cacheSize, config.cacheLineSize, config.cacheAssociativity),
+      dram(config),
+      predictor(config.predictor, config.predictorEntries)
+{
+    now = 0;
+    registerReady.assign(32, 0);
+    unitFree.assign(OPCODE_COUNT, 0);
+    lastMiss = false;
+    lastMispredict = false;
+}
+
+int TimingModel::memoryStall(int addr, int words, bool write, int stall)
+{
+    if(!hasDram)
+    {
+        return config.memoryLatency;
+    }
+
+    //the pipeline is frozen while it waits, so the stalls so far (including this instruction's) have already elapsed
+    long long when = now + stats.stallCycles + stall;
+    if(write)
+    {
+        return dram.write(addr, words, when, stats) - when;
+    }
+    return dram.read(addr, words, when, stats) - when;
+}
+
+int TimingModel::retire(const RetireRecord& record)
+{
+    int stall = 0;
+
+    stats.retired++;
+    now++;
+    lastMiss = false;
+    lastMispredict = false;
+
+    //Scoreboard for multi-cycle units: ID waits for sources still being computed, EX waits for a busy unpipelined unit,
+    //and a write may not overtake an older, slower write to the same register.
+    //WB runs before ID within a cycle, so a single-cycle result is readable three slots later, as the scheduler assumes.
+    //Only multi-cycle results are tracked: reading a register sooner than that is a hazard the functional pipeline
+    //answers with the stale value, so it costs no cycles and only the extra latency beyond the plain distance stalls
+    long long id = now + stats.stallCycles;
+    int dataStall = 0;
+    for(int r : { record.src1, record.src2 })
+    {
+        if(r > 0 && registerReady[r] > id + dataStall)
+        {
+            dataStall = registerReady[r] - id;
+        }
+    }
+
+    int latency = config.opLatency[record.opcode];
+    long long ex = id + dataStall + 1;
+    int unitStall = 0;
+    if(!config.opPipelined[record.opcode] && unitFree[record.opcode] > ex)
+    {
+        unitStall = unitFree[record.opcode] - ex;
+        ex += unitStall;
+    }
+    unitFree[record.opcode] = ex + latency;
+
+    if(record.dest > 0)
+    {
+        long long ready = ex + latency + 1; //through MEM, then written in WB and read by ID in the same cycle
+        if(registerReady[record.dest] > ready)
+        {
+            dataStall += registerReady[record.dest] - ready;
+            ready = registerReady[record.dest];
+        }
+        registerReady[record.dest] = latency > 1 ? ready : 0;
+    }
+
+    stall += dataStall + unitStall;
+    stats.dataStalls += dataStall;
+    stats.unitStalls += unitStall;
+
+    if(record.memRead || record.memWrite)
+    {
+        stats.memoryAccesses++;
+        int before = stall;
+
+        if(hasCache)
+        {
+            bool writeBack;
+            int writeBackAddr;
+            stall += config.cacheHitLatency;
+            if(!cache.access(record.memAddr, record.memWrite, writeBack, writeBackAddr))
+            {
+                stats.cacheMisses++;
+                lastMiss = true;
+                if(writeBack && hasDram) //write backs are buffered and only stall when the DRAM write queue is full
+                {
+                    stall += memoryStall(writeBackAddr, config.cacheLineSize, true, stall);
+                }
+                stall += memoryStall(record.memAddr - record.memAddr % config.cacheLineSize, config.cacheLineSize, false, stall);
+            }
+            if(writeBack)
+            {
+                stats.writeBacks++;
+            }
+        }
+        else
+        {
+            stall += memoryStall(record.memAddr, 1, record.memWrite, stall);
+        }
+        stats.memoryStalls += stall - before;
+    }
+
+    if(record.conditional)
+    {
+        stats.branches++;
+
+        if(!perfectPredictor)
+        {
+            if(predictor.predict(record.pc) != record.taken)
+            {
+                stats.mispredictions++;
+                lastMispredict = true;
+                //a comparator in ID resolves beq one cycle earlier than the ALU in EX
+                int penalty = std::max(0, config.mispredictPenalty - (config.branchStage == "id" ? 1 : 0));
+                stall += penalty;
+                stats.branchStalls += penalty;
+            }
+            predictor.update(record.pc, record.taken);
+        }
+    }
+
+    stats.stallCycles += stall;
+    return stall;
+}
+
+void TimingModel::finish()
+{
+    //the writes complete after the program has ended, so they add traffic but no cycles
+    if(hasDram)
+    {
+        dram.flush(stats);
+    }
+}
+
+const TimingStats& TimingModel::getStats() const
+{
+    return stats;
+}
+
+bool TimingModel::lastAccessMissed() const
+{
+    return lastMiss;
+}
+
+bool TimingModel::lastBranchMispredicted() const
+{
+    return lastMispredict;
+}
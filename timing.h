@@ -0,0 +1,217 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <string>
+#include <vector>
+#include <deque>
+
+//Opcodes the timing models tell apart, named as in OPCODE_NAMES
+enum OPCODE
+{
+    OP_ADD, OP_ADDI, OP_SUB, OP_MULT, OP_AND, OP_OR, OP_SLL, OP_SRL,
+    OP_LI, OP_LA, OP_LW, OP_SW, OP_BEQ, OP_J, OP_NOP,
+    OPCODE_COUNT
+};
+
+const char* const OPCODE_NAMES[OPCODE_COUNT] =
+{
+    "add", "addi", "sub", "mult", "and", "or", "sll", "srl",
+    "li", "la", "lw", "sw", "beq", "j", "nop"
+};
+
+//Everything the timing models need to know about one instruction, filled in as it moves down the pipeline
+struct RetireRecord
+{
+    int pc = 0; //instruction index
+    int opcode = OP_NOP;
+    int dest = -1; //register written in WB, -1 for none or $zero
+    int src1 = -1; //registers read in ID, -1 for none
+    int src2 = -1;
+    bool memRead = false;
+    bool memWrite = false;
+    int memAddr = 0;
+    bool branch = false; //beq or j
+    bool conditional = false; //beq only
+    bool taken = false;
+};
+
+//Microarchitecture parameters. The defaults describe the ideal pipeline (no stalls)
+struct TimingConfig
+{
+    int cacheSize = 0; //data cache capacity in words, 0 = no cache
+    int cacheLineSize = 4; //words per line
+    int cacheAssociativity = 1;
+    int cacheHitLatency = 0; //extra cycles on a cache hit
+    int memoryLatency = 0; //cycles to reach main memory (cache miss penalty) with the fixed memory model
+    std::string memoryModel = "fixed"; //fixed or dram
+    int dramChannels = 1;
+    int dramBanks = 8; //per channel
+    int dramRowSize = 256; //words per row
+    std::string dramPolicy = "open"; //open or closed row buffers
+    int dramRCD = 14; //activate to column command
+    int dramCAS = 14; //column command to data
+    int dramRP = 14; //precharge
+    int dramWidth = 1; //words per data bus cycle
+    int dramQueue = 16; //posted write queue entries
+    std::string predictor = "perfect"; //perfect, not-taken, taken or bimodal
+    int predictorEntries = 64; //bimodal table size
+    int mispredictPenalty = 2; //cycles lost on a mispredicted beq resolved in EX
+    std::string branchStage = "ex"; //id or ex, where beq is resolved
+    std::vector<int> opLatency = std::vector<int>(OPCODE_COUNT, 1); //cycles in EX per OPCODE
+    std::vector<int> opPipelined = std::vector<int>(OPCODE_COUNT, 1); //0 = the unit accepts one instruction at a time
+
+    bool set(const std::string& key, const std::string& value, std::string& error); //false with error set for an unknown key or bad value
+
+    std::string get(const std::string& key) const;
+
+    bool isValid(std::string& error) const;
+};
+
+struct TimingStats
+{
+    long long retired = 0;
+    long long stallCycles = 0;
+    long long memoryAccesses = 0;
+    long long cacheMisses = 0;
+    long long writeBacks = 0;
+    long long branches = 0; //conditional branches only
+    long long mispredictions = 0;
+    long long memoryStalls = 0; //stall cycles by cause, they add up to stallCycles
+    long long branchStalls = 0;
+    long long dataStalls = 0; //waiting for a multi-cycle result
+    long long unitStalls = 0; //waiting for an unpipelined unit
+    long long dramReads = 0;
+    long long dramWrites = 0;
+    long long rowHits = 0;
+    long long rowConflicts = 0; //a different row was open, the rest found the bank precharged
+    long long dramWords = 0; //words moved over the data bus
+    long long dramLastTransfer = 0; //cycle the last transfer ended, later than the run for writes flushed at the end
+};
+
+//Set-associative, write-back, write-allocate cache with LRU replacement
+class Cache
+{
+    public:
+
+        Cache(int size, int lineSize, int associativity);
+
+        bool access(int addr, bool write, bool& writeBack, int& writeBackAddr); //returns true on a hit
+
+    private:
+
+        struct Line
+        {
+            bool valid;
+            bool dirty;
+            int tag;
+            long long lastUse;
+        };
+
+        int lineSize;
+        int associativity;
+        int numSets;
+        long long useCounter;
+        std::vector<Line> lines; //numSets * associativity lines, set-major
+};
+
+//Main memory as channels of banks with one row buffer each.
+//Addresses are interleaved row by row across channels, then banks. Reads are demand requests the pipeline waits for,
+//writes are posted to a queue that drains while the banks are idle. Both are scheduled FR-FCFS (row hits first, then oldest)
+class DramModel
+{
+    public:
+
+        DramModel(const TimingConfig& config);
+
+        long long read(int addr, int words, long long now, TimingStats& stats); //returns the cycle the data has arrived
+
+        long long write(int addr, int words, long long now, TimingStats& stats); //returns the cycle the queue accepted the write
+
+        void flush(TimingStats& stats); //services every queued write
+
+    private:
+
+        struct Request
+        {
+            int channel;
+            int bank;
+            int row;
+            int words;
+            bool write;
+            long long arrival;
+        };
+
+        struct Bank
+        {
+            int openRow; //-1 when precharged
+            long long readyAt;
+        };
+
+        TimingConfig config;
+        std::vector<Bank> banks; //dramChannels * dramBanks, channel-major
+        std::vector<long long> busFreeAt; //per channel
+        std::deque<Request> queue; //oldest first
+
+        Request makeRequest(int addr, int words, bool write, long long now) const;
+
+        int pick(int channel) const; //queue index FR-FCFS issues next on the channel, -1 if none
+
+        long long service(const Request& request, long long& start, TimingStats& stats); //returns the cycle the transfer ends
+
+        void drain(long long now, TimingStats& stats); //issues the queued writes that would have started before now
+};
+
+class BranchPredictor
+{
+    public:
+
+        BranchPredictor(const std::string& type, int entries);
+
+        bool predict(int pc) const;
+
+        void update(int pc, bool taken);
+
+    private:
+
+        std::string type;
+        std::vector<unsigned char> counters; //2-bit saturating counters for bimodal
+};
+
+//Turns the retired instruction stream into stall cycles.
+//The pipeline is stalled as a whole, so the functional results never depend on the configuration
+class TimingModel
+{
+    public:
+
+        TimingModel(const TimingConfig& config);
+
+        int retire(const RetireRecord& record); //returns the stall cycles caused by this instruction
+
+        void finish(); //call after the last retire, so writes still queued in DRAM are counted
+
+        const TimingStats& getStats() const;
+
+        bool lastAccessMissed() const; //outcome of the most recent retire() call
+
+        bool lastBranchMispredicted() const;
+
+    private:
+
+        TimingConfig config;
+        TimingStats stats;
+        long long now; //cycle of the current retire, relative to the first one
+        std::vector<long long> registerReady; //scoreboard: first cycle ID can read each register
+        std::vector<long long> unitFree; //first cycle each opcode's unit accepts a new instruction
+        bool lastMiss;
+        bool lastMispredict;
+        bool hasCache;
+        bool perfectPredictor;
+        bool hasDram;
+        Cache cache;
+        DramModel dram;
+        BranchPredictor predictor;
+
+        int memoryStall(int addr, int words, bool write, int stall); //cycles the pipeline waits for a main memory access, stall is this instruction's stall so far
+};
+
+#endif